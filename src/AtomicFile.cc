@@ -0,0 +1,49 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AtomicFile.h"
+
+void writeFileAtomic(const std::string& path, const std::string& text,
+                     mode_t mode) {
+  // concurrent writers of same file each have their own temporary file
+  std::string tmp = path + ".XXXXXX";
+  int fd = ::mkstemp(&tmp[0]);
+  if (fd < 0)
+    throw std::runtime_error("AtomicFile::open " + tmp + ": " +
+                             std::strerror(errno));
+  bool ok = (::fchmod(fd, mode) == 0);
+  ok = ok && (::write(fd, text.data(), text.size()) ==
+              static_cast<ssize_t>(text.size()));
+  ok = ok && (::fsync(fd) == 0);
+  ::close(fd);
+  if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    int err = errno;
+    ::unlink(tmp.c_str());
+    throw std::runtime_error("AtomicFile::write " + path + ": " +
+                             std::strerror(err));
+  }
+}
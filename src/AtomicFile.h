@@ -0,0 +1,34 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <string>
+
+#include <sys/types.h>
+
+/// \brief Replaces file 'path' by 'text' so that readers see either the old
+/// or the new file. Text is written into a unique temporary file in the same
+/// directory with permissions 'mode', synced and renamed over 'path'.
+/// Throws std::runtime_error on failure, old file is then left as it was.
+void writeFileAtomic(const std::string& path, const std::string& text,
+                     mode_t mode);
+
+#endif  // ATOMICFILE_H
@@ -0,0 +1,58 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BYTEVIEW_H
+#define BYTEVIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+///
+/// \brief Non-owning view of contiguous bytes.
+///
+/// Lets passwords, salts and encoded keys be passed from any buffer
+/// without copying. Viewed memory must outlive the view.
+///
+class ByteView {
+ public:
+  ByteView() : data_(nullptr), size_(0) {}
+  ByteView(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+  template <class Alloc>
+  ByteView(const std::vector<uint8_t, Alloc>& v)
+      : data_(v.data()), size_(v.size()) {}
+  ByteView(const std::string& s)
+      : data_(reinterpret_cast<const uint8_t*>(s.data())), size_(s.size()) {}
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const uint8_t* begin() const { return data_; }
+  const uint8_t* end() const { return data_ + size_; }
+
+  uint8_t operator[](size_t i) const { return data_[i]; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+};
+
+#endif  // BYTEVIEW_H
@@ -0,0 +1,93 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CANCELTOKEN_H
+#define CANCELTOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+///
+/// \brief Cancellation request and deadline of a long computation.
+///
+/// Computation polls check() at intervals, the token is cancelled by any
+/// thread or expires when deadline passes. Token fires also when its
+/// parent token fires.
+///
+class CancelToken {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Status { kActive, kCancelled, kTimeout };
+
+  CancelToken()
+      : cancelled_(false),
+        deadline_(Clock::time_point::max()),
+        parent_(nullptr) {}
+  explicit CancelToken(Clock::time_point deadline,
+                       const CancelToken* parent = nullptr)
+      : cancelled_(false), deadline_(deadline), parent_(parent) {}
+
+  CancelToken(const CancelToken&) = delete;
+  CancelToken& operator=(const CancelToken&) = delete;
+
+  void cancel() { cancelled_ = true; }
+
+  Status status() const {
+    if (parent_ != nullptr) {
+      Status s = parent_->status();
+      if (s != Status::kActive) return s;
+    }
+    if (cancelled_) return Status::kCancelled;
+    if (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_)
+      return Status::kTimeout;
+    return Status::kActive;
+  }
+
+  /// \brief Throws OperationCancelled when cancelled or expired.
+  inline void check() const;
+
+ private:
+  std::atomic<bool> cancelled_;
+  Clock::time_point deadline_;
+  const CancelToken* parent_;
+};
+
+/// \brief Thrown out of computation when its CancelToken fires.
+class OperationCancelled : public std::runtime_error {
+ public:
+  explicit OperationCancelled(CancelToken::Status status)
+      : std::runtime_error(status == CancelToken::Status::kTimeout
+                               ? "timeout"
+                               : "cancelled"),
+        status_(status) {}
+
+  CancelToken::Status status() const { return status_; }
+
+ private:
+  CancelToken::Status status_;
+};
+
+inline void CancelToken::check() const {
+  Status s = status();
+  if (s != Status::kActive) throw OperationCancelled(s);
+}
+
+#endif  // CANCELTOKEN_H
@@ -0,0 +1,304 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "CoinEncoding.h"
+#include "KeySerializer.h"
+#include "StageStats.h"
+#include "sha256.h"
+
+using namespace cppcrypto;
+
+namespace {
+constexpr char BASE58_CHARS[] =
+    "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+/// \brief Reverse lookup table of base58 alphabet, -1 for invalid chars.
+struct Base58Table {
+  constexpr Base58Table() : digit_() {
+    for (int i = 0; i < 256; i++) digit_[i] = -1;
+    for (int i = 0; i < 58; i++)
+      digit_[static_cast<uint8_t>(BASE58_CHARS[i])] = static_cast<int8_t>(i);
+  }
+  int8_t digit_[256];
+};
+constexpr Base58Table BASE58_DIGITS;
+
+const std::map<CoinId, CoinParams> COIN_PARAMS = {
+    {CoinId::kBitCoin, {0x00, 0x80}},
+    {CoinId::kBitCoinTest, {0x6f, 0xef}},
+    {CoinId::kLiteCoin, {0x30, 0xb0}},
+    {CoinId::kLiteCoinTest, {0x6f, 0xef}}};
+
+// --- RIPEMD-160 ---
+
+inline uint32_t rol(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+/// message word selection and rotation amounts of left and right lines
+const uint8_t RMD_R[80] = {
+    0, 1, 2,  3,  4,  5,  6,  7,  8, 9, 10, 11, 12, 13, 14, 15, 7,  4,  13, 1,
+    10, 6, 15, 3, 12, 0, 9,  5,  2, 14, 11, 8, 3,  10, 14, 4,  9,  15, 8,  1,
+    2,  7, 0,  6,  13, 11, 5,  12, 1, 9,  11, 10, 0,  8,  12, 4,  13, 3,  7,  15,
+    14, 5, 6,  2,  4,  0,  5,  9,  7, 12, 2,  10, 14, 1,  3,  8,  11, 6,  15, 13};
+const uint8_t RMD_RP[80] = {
+    5,  14, 7,  0, 9, 2,  11, 4,  13, 6,  15, 8,  1,  10, 3,  12, 6,  11, 3,  7,
+    0,  13, 5,  10, 14, 15, 8,  12, 4,  9,  1,  2,  15, 5,  1,  3,  7,  14, 6,  9,
+    11, 8,  12, 2,  10, 0,  4,  13, 8,  6,  4,  1,  3,  11, 15, 0,  5,  12, 2,  13,
+    9,  7,  10, 14, 12, 15, 10, 4,  1,  5,  8,  7,  6,  2,  13, 14, 0,  3,  9,  11};
+const uint8_t RMD_S[80] = {
+    11, 14, 15, 12, 5,  8,  7,  9,  11, 13, 14, 15, 6,  7,  9,  8,  7,  6,  8,  13,
+    11, 9,  7,  15, 7,  12, 15, 9,  11, 7,  13, 12, 11, 13, 6,  7,  14, 9,  13, 15,
+    14, 8,  13, 6,  5,  12, 7,  5,  11, 12, 14, 15, 14, 15, 9,  8,  9,  14, 5,  6,
+    8,  6,  5,  12, 9,  15, 5,  11, 6,  8,  13, 12, 5,  12, 13, 14, 11, 8,  5,  6};
+const uint8_t RMD_SP[80] = {
+    8,  9,  9,  11, 13, 15, 15, 5,  7,  7,  8,  11, 14, 14, 12, 6,  9,  13, 15, 7,
+    12, 8,  9,  11, 7,  7,  12, 7,  6,  15, 13, 11, 9,  7,  15, 11, 8,  6,  6,  14,
+    12, 13, 5,  14, 13, 13, 7,  5,  15, 5,  8,  11, 14, 14, 6,  14, 6,  9,  12, 9,
+    12, 5,  15, 8,  8,  5,  12, 9,  12, 5,  14, 6,  8,  13, 6,  5,  15, 13, 11, 11};
+const uint32_t RMD_K[5] = {0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC,
+                           0xA953FD4E};
+const uint32_t RMD_KP[5] = {0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9,
+                            0x00000000};
+
+inline uint32_t rmdF(int j, uint32_t x, uint32_t y, uint32_t z) {
+  switch (j / 16) {
+    case 0:
+      return x ^ y ^ z;
+    case 1:
+      return (x & y) | (~x & z);
+    case 2:
+      return (x | ~y) ^ z;
+    case 3:
+      return (x & z) | (y & ~z);
+    default:
+      return x ^ (y | ~z);
+  }
+}
+
+void rmdCompress(uint32_t* h, const uint8_t* block) {
+  uint32_t x[16];
+  for (int i = 0; i < 16; i++)
+    x[i] = uint32_t(block[4 * i]) | uint32_t(block[4 * i + 1]) << 8 |
+           uint32_t(block[4 * i + 2]) << 16 | uint32_t(block[4 * i + 3]) << 24;
+  uint32_t al = h[0], bl = h[1], cl = h[2], dl = h[3], el = h[4];
+  uint32_t ar = al, br = bl, cr = cl, dr = dl, er = el;
+  for (int j = 0; j < 80; j++) {
+    uint32_t t = rol(al + rmdF(j, bl, cl, dl) + x[RMD_R[j]] + RMD_K[j / 16],
+                     RMD_S[j]) + el;
+    al = el;
+    el = dl;
+    dl = rol(cl, 10);
+    cl = bl;
+    bl = t;
+    t = rol(ar + rmdF(79 - j, br, cr, dr) + x[RMD_RP[j]] + RMD_KP[j / 16],
+            RMD_SP[j]) + er;
+    ar = er;
+    er = dr;
+    dr = rol(cr, 10);
+    cr = br;
+    br = t;
+  }
+  uint32_t t = h[1] + cl + dr;
+  h[1] = h[2] + dl + er;
+  h[2] = h[3] + el + ar;
+  h[3] = h[4] + al + br;
+  h[4] = h[0] + bl + cr;
+  h[0] = t;
+}
+
+int hexDigit(uint8_t c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+}
+
+const CoinParams& coinParams(CoinId id) { return COIN_PARAMS.at(id); }
+
+void sha256d(const uint8_t* data, size_t len, uint8_t out[32]) {
+  sha256 h;
+  uint8_t tmp[32];
+  h.hash_string(data, len, tmp);
+  h.hash_string(tmp, sizeof(tmp), out);
+}
+
+void ripemd160(const uint8_t* data, size_t len, uint8_t out[20]) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                   0xC3D2E1F0};
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64) rmdCompress(h, data + i);
+
+  // padding, message length in bits little-endian
+  uint8_t block[128] = {0};
+  size_t rest = len - i;
+  std::copy(data + i, data + len, block);
+  block[rest] = 0x80;
+  size_t blocks = (rest + 9 <= 64 ? 1 : 2);
+  uint64_t bits = uint64_t(len) * 8;
+  for (int k = 0; k < 8; k++)
+    block[blocks * 64 - 8 + k] = static_cast<uint8_t>(bits >> (8 * k));
+  for (size_t k = 0; k < blocks; k++) rmdCompress(h, block + 64 * k);
+
+  for (int k = 0; k < 5; k++)
+    for (int b = 0; b < 4; b++)
+      out[4 * k + b] = static_cast<uint8_t>(h[k] >> (8 * b));
+}
+
+void hash160(const uint8_t* data, size_t len, uint8_t out[20]) {
+  sha256 h;
+  uint8_t tmp[32];
+  h.hash_string(data, len, tmp);
+  ripemd160(tmp, sizeof(tmp), out);
+}
+
+std::string hash160ToAddress(CoinId id, const uint8_t hash[20]) {
+  uint8_t payload[21];
+  payload[0] = coinParams(id).address_;
+  std::copy(hash, hash + 20, payload + 1);
+  return base58CheckEncode(payload, sizeof(payload));
+}
+
+std::string secretToWif(CoinId id, const uint8_t* secret, bool compressed) {
+  uint8_t payload[34];
+  payload[0] = coinParams(id).wif_;
+  std::copy(secret, secret + 32, payload + 1);
+  size_t len = 33;
+  if (compressed) payload[len++] = 0x01;
+  return base58CheckEncode(payload, len);
+}
+
+CoinKeyPair encodeKeyPair(CoinId id, const uint8_t* pub, size_t pub_len,
+                          const uint8_t* secret) {
+  StageTimer timer(Stage::kEncoding);
+  bool compressed = (pub_len == 33);
+  uint8_t hash[20];
+  hash160(pub, pub_len, hash);
+  std::string addr = hash160ToAddress(id, hash);
+  std::string hex;
+  appendHex(hex, pub, pub_len);
+  std::string wif;
+  if (secret != nullptr) wif = secretToWif(id, secret, compressed);
+  return CoinKeyPair(id, compressed, ByteVect(addr.begin(), addr.end()),
+                     ByteVect(hex.begin(), hex.end()),
+                     ByteVect(wif.begin(), wif.end()));
+}
+
+std::string base58Encode(const uint8_t* data, size_t len) {
+  // leading zero bytes are encoded as '1'
+  size_t zeros = 0;
+  while (zeros < len && data[zeros] == 0) zeros++;
+
+  // base conversion, log(256) / log(58) ~ 1.37
+  std::vector<uint8_t> b58((len - zeros) * 138 / 100 + 1, 0);
+  size_t used = 0;
+  for (size_t i = zeros; i < len; i++) {
+    unsigned int carry = data[i];
+    size_t k = 0;
+    for (auto it = b58.rbegin(); (carry != 0 || k < used) && it != b58.rend();
+         ++it, ++k) {
+      carry += 256 * (*it);
+      *it = carry % 58;
+      carry /= 58;
+    }
+    used = k;
+  }
+  auto it = b58.begin() + (b58.size() - used);
+  std::string s(zeros, '1');
+  s.reserve(zeros + used);
+  for (; it != b58.end(); ++it) s += BASE58_CHARS[*it];
+  return s;
+}
+
+bool base58Decode(const uint8_t* data, size_t len, ByteVect& out) {
+  size_t ones = 0;
+  while (ones < len && data[ones] == '1') ones++;
+
+  // log(58) / log(256) ~ 0.733
+  std::vector<uint8_t> b256((len - ones) * 733 / 1000 + 1, 0);
+  size_t used = 0;
+  for (size_t i = ones; i < len; i++) {
+    int d = BASE58_DIGITS.digit_[data[i]];
+    if (d < 0) return false;
+    unsigned int carry = static_cast<unsigned int>(d);
+    size_t k = 0;
+    for (auto it = b256.rbegin();
+         (carry != 0 || k < used) && it != b256.rend(); ++it, ++k) {
+      carry += 58 * (*it);
+      *it = carry % 256;
+      carry /= 256;
+    }
+    used = k;
+  }
+  out.assign(ones, 0);
+  out.insert(out.end(), b256.end() - used, b256.end());
+  return true;
+}
+
+std::string base58CheckEncode(const uint8_t* data, size_t len) {
+  ByteVect buf(data, data + len);
+  uint8_t hash[32];
+  sha256d(data, len, hash);
+  buf.insert(buf.end(), hash, hash + 4);
+  return base58Encode(buf.data(), buf.size());
+}
+
+bool base58CheckDecode(const uint8_t* data, size_t len, ByteVect& out) {
+  if (!base58Decode(data, len, out) || out.size() < 4) return false;
+  uint8_t hash[32];
+  sha256d(out.data(), out.size() - 4, hash);
+  if (!std::equal(hash, hash + 4, out.end() - 4)) return false;
+  out.resize(out.size() - 4);
+  return true;
+}
+
+bool addressToHash160(ByteView address, uint8_t out[20]) {
+  ByteVect payload;
+  if (!base58CheckDecode(address.data(), address.size(), payload) ||
+      payload.size() != 21)
+    return false;
+  std::copy(payload.begin() + 1, payload.end(), out);
+  return true;
+}
+
+bool wifToSecret(ByteView wif, SecretKey& out) {
+  // version + secret [+ compression flag 0x01]
+  ByteVect payload;
+  if (!base58CheckDecode(wif.data(), wif.size(), payload)) return false;
+  if (payload.size() != 33 && !(payload.size() == 34 && payload[33] == 0x01))
+    return false;
+  std::copy(payload.begin() + 1, payload.begin() + 33, out.begin());
+  return true;
+}
+
+bool hexDecode(const uint8_t* data, size_t len, ByteVect& out) {
+  if (len % 2 != 0) return false;
+  out.resize(len / 2);
+  for (size_t i = 0; i < len / 2; i++) {
+    int hi = hexDigit(data[2 * i]);
+    int lo = hexDigit(data[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = static_cast<uint8_t>(hi << 4 | lo);
+  }
+  return true;
+}
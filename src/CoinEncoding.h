@@ -0,0 +1,80 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef COINENCODING_H
+#define COINENCODING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ByteView.h"
+#include "CoinKeyPair.h"
+
+/// \brief Network specific version bytes used by key encodings.
+struct CoinParams {
+  uint8_t address_;  /// base58check version of pay-to-pubkey-hash address
+  uint8_t wif_;      /// base58check version of private key WIF
+};
+
+/// \brief Returns encoding parameters of network.
+const CoinParams& coinParams(CoinId id);
+
+/// \brief Base58 encoding of data.
+std::string base58Encode(const uint8_t* data, size_t len);
+
+/// \brief Base58 decoding, returns false if input has invalid characters.
+bool base58Decode(const uint8_t* data, size_t len, ByteVect& out);
+
+/// \brief Base58 encoding of data with 4-byte double SHA-256 checksum.
+std::string base58CheckEncode(const uint8_t* data, size_t len);
+
+/// \brief Base58check decoding, returns false if checksum does not match.
+bool base58CheckDecode(const uint8_t* data, size_t len, ByteVect& out);
+
+/// \brief Double SHA-256 of data.
+void sha256d(const uint8_t* data, size_t len, uint8_t out[32]);
+
+/// \brief RIPEMD-160 of data.
+void ripemd160(const uint8_t* data, size_t len, uint8_t out[20]);
+
+/// \brief RIPEMD-160 of SHA-256 of data.
+void hash160(const uint8_t* data, size_t len, uint8_t out[20]);
+
+/// \brief Base58check address of public key hash.
+std::string hash160ToAddress(CoinId id, const uint8_t hash[20]);
+
+/// \brief Private key WIF of secret.
+std::string secretToWif(CoinId id, const uint8_t* secret, bool compressed);
+
+/// \brief Creates coin key pair from serialized public key (33 or 65 bytes)
+/// and secret, secret is optional for watch-only keys.
+CoinKeyPair encodeKeyPair(CoinId id, const uint8_t* pub, size_t pub_len,
+                          const uint8_t* secret = nullptr);
+
+/// \brief Extracts 20-byte public key hash from base58check address.
+bool addressToHash160(ByteView address, uint8_t out[20]);
+
+/// \brief Extracts 32-byte secret from private key WIF.
+bool wifToSecret(ByteView wif, SecretKey& out);
+
+/// \brief Decodes hex string into bytes.
+bool hexDecode(const uint8_t* data, size_t len, ByteVect& out);
+
+#endif  // COINENCODING_H
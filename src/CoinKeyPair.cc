@@ -25,17 +25,18 @@
 #include <iterator>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <sstream>
 
 #include "CoinKeyPair.h"
+#include "KeySerializer.h"
+#include "StageStats.h"
 #include "lib_bitcointool.h"
 
 std::string byte2HexString(const uint8_t* data, int len) {
-  std::stringstream ss;
-  ss << std::hex;
-  for (int i = 0; i < len; ++i)
-    ss << std::setw(2) << std::setfill('0') << (unsigned)data[i];
-  return ss.str();
+  std::string s;
+  appendHex(s, data, len);
+  return s;
 }
 
 std::vector<uint8_t> string2ByteArray(char* s, unsigned int s_len) {
@@ -59,6 +60,9 @@ const std::map<CoinId, std::string> NETWORK_TYPE = {
     {CoinId::kBitCoinTest, "bitcoin-testnet"},
     {CoinId::kLiteCoin, "litecoin"},
     {CoinId::kLiteCoinTest, "litecoin-testnet"}};
+
+/// bitcoin-tool is not reentrant, serialize calls from worker threads
+std::mutex BITCOIN_TOOL_MUTEX;
 }
 
 void CoinKeyPair::create(const uint8_t* secret, unsigned int secret_len) {
@@ -72,7 +76,9 @@ void CoinKeyPair::create(const uint8_t* secret, unsigned int secret_len) {
   argv.at(4) = (compressed_ ? "compressed" : "uncompressed");
   argv.back() = s.c_str();
 
-  // run command using bitcoin-tool
+  // run command using bitcoin-tool, it does EC multiplication and encoding
+  std::lock_guard<std::mutex> lock(BITCOIN_TOOL_MUTEX);
+  StageTimer timer(Stage::kEc);
   LibBitcoinTool tool;
   int err = tool.run(argv.size(), argv.data());
   if (err == -1)
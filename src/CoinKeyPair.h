@@ -24,9 +24,21 @@
 #include <cstdint>
 #include <vector>
 
+#include "SecureMemory.h"
+
 enum class CoinId { kBitCoin = 1, kBitCoinTest, kLiteCoin, kLiteCoinTest };
 
-using SecretKey = std::array<uint8_t, 32>;
+/// \brief Private key or key seed, wiped when destroyed.
+struct SecretKey : std::array<uint8_t, 32> {
+  SecretKey() = default;
+  SecretKey(const SecretKey&) = default;
+  SecretKey& operator=(const SecretKey&) = default;
+  ~SecretKey() { secureWipe(data(), size()); }
+};
+
+/// \brief Secret keys in locked memory, see SecurePool.
+using SecretKeys = std::vector<SecretKey, SecureAllocator<SecretKey>>;
+
 using ByteVect = std::vector<uint8_t>;
 
 /// \class CoinKeyPair
@@ -42,7 +54,7 @@ class CoinKeyPair {
         priv_(priv) {}
 
   /// \brief Compares keypair to other key pair.
-  bool equals(CoinKeyPair& rhs) const {
+  bool equals(const CoinKeyPair& rhs) const {
     return (rhs.id() == network_ && rhs.address() == addr_);
   }
 
@@ -50,9 +62,10 @@ class CoinKeyPair {
   void create(const uint8_t* secret, unsigned int secret_len);
 
   CoinId id() const { return network_; }
-  ByteVect address() const { return addr_; }
-  ByteVect publicKey() const { return pub_; }
-  ByteVect privateKey() const { return priv_; }
+  bool compressed() const { return compressed_; }
+  const ByteVect& address() const { return addr_; }
+  const ByteVect& publicKey() const { return pub_; }
+  const ByteVect& privateKey() const { return priv_; }
 
  private:
   CoinId network_;   /// network
@@ -18,30 +18,187 @@
 ** along with this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <ctime>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 
+#include "CancelToken.h"
 #include "CoinKeyPair.h"
+#include "CoinEncoding.h"
 #include "CommandInterpreter.h"
+#include "DerivationCache.h"
+#include "HDWallet.h"
+#include "JobServer.h"
+#include "KeyPipeline.h"
+#include "KeyExport.h"
+#include "MachineProfile.h"
+#include "PerfCounters.h"
+#include "ProgressMeter.h"
+#include "RootKeyCache.h"
+#include "Secp256k1.h"
+#include "SecureMemory.h"
+#include "Sha256Engine.h"
 #include "UserInterface.h"
 #include "WarpKeyGenerator.h"
 
 extern std::string byte2HexString(const uint8_t* data, int len);
 
 namespace {
-std::string ByteVect2String(const ByteVect& v) {
-  std::ostringstream ss;
-  if (!v.empty()) {
-    std::copy(std::begin(v), std::end(v),
-              std::ostream_iterator<unsigned char>(ss));
+/// HD wallet keys derived by one task
+const uint32_t HD_BLOCK_SIZE{64};
+
+/// watch-only public keys derived by one task, sharing one field inversion
+const uint32_t XPUB_BLOCK_SIZE{256};
+
+/// DTS v2 wallet keys derived by one task, sharing one field inversion
+const uint32_t DTS_BLOCK_SIZE{256};
+
+/// \brief Wipes string holding secret, e.g. hex of root key, when leaving
+/// scope.
+class WipeOnExit {
+ public:
+  explicit WipeOnExit(std::string& s) : s_(s) {}
+  ~WipeOnExit() { secureWipe(&s_[0], s_.size()); }
+
+  WipeOnExit(const WipeOnExit&) = delete;
+  WipeOnExit& operator=(const WipeOnExit&) = delete;
+
+ private:
+  std::string& s_;
+};
+
+/// \brief Wallet type of simple deterministic wallet in JSON output.
+std::string dtsType(const UserInterface::WalletDTS& wallet) {
+  return (wallet.version_ == 2 ? "deterministic-simple-v2"
+                               : "deterministic-simple");
+}
+
+/// \brief Whether 'count' random passwords of 'length' characters need
+/// duplicate filtering, i.e. expected duplicates count^2 / (2 * 62^length)
+/// is not negligible (>= 2^-32).
+bool needsUniquePasswords(uint64_t count, uint16_t length) {
+  double space = std::pow(62.0, length);
+  return static_cast<double>(count) * count / (2.0 * space) >=
+         std::ldexp(1.0, -32);
+}
+
+std::string ByteVect2String(ByteView v) {
+  return std::string(v.begin(), v.end());
+}
+
+/// \brief Command number of batch job, given as number or operation name.
+std::string batchCommand(const json& cmd) {
+  static const std::vector<std::string> names{
+      OPER_GENERATE_COIN,       OPER_GENERATE_COIN_RANDOM,
+      OPER_ATTACH,              OPER__GENERATE_WALLET_DTS,
+      OPER__GENERATE_WALLET_HD, OPER_TEST,
+      OPER_GENERATE_ADDRESSES_XPUB};
+  size_t n{0};
+  if (cmd.is_number_unsigned()) {
+    n = cmd.get<size_t>();
+  } else if (cmd.is_string()) {
+    auto it = std::find(names.begin(), names.end(), cmd.get<std::string>());
+    if (it != names.end()) n = (it - names.begin()) + 1;
+  }
+  if (n < 1 || n > names.size())
+    throw std::invalid_argument("batch: unknown job command");
+  return std::to_string(n);
+}
+
+/// \brief Resets peak resident set size of process, false when kernel does
+/// not support it.
+bool resetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5" << std::flush;
+  return static_cast<bool>(clear_refs);
+}
+
+/// \brief Peak resident set size of process in bytes, 0 when unknown.
+uint64_t peakRss() {
+  std::ifstream status("/proc/self/status");
+  std::string name;
+  while (status >> name) {
+    if (name == "VmHWM:") {
+      uint64_t kb{0};
+      status >> kb;
+      return kb * 1024;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return 0;
+}
+
+/// \brief Totals, means and duration histogram of timed stages, histogram
+/// buckets are per item durations of [us, 2 * us).
+json stageJSON(const std::vector<StageSummary>& stages) {
+  json out = json::object();
+  for (auto& s : stages) {
+    json& j = out[StageStats::name(s.stage_)];
+    j["count"] = s.count_;
+    j["calls"] = s.calls_;
+    j["totalMs"] = s.total_ns_ / 1e6;
+    j["meanUs"] = (s.count_ ? s.total_ns_ / 1e3 / s.count_ : 0.0);
+    j["maxCallUs"] = s.max_ns_ / 1e3;
+    j["histogram"] = json::array();
+    for (size_t k = 0; k < s.histogram_.size(); k++)
+      if (s.histogram_[k] != 0)
+        j["histogram"].push_back({{"us", uint64_t(1) << k},
+                                  {"count", s.histogram_[k]}});
+    if (s.perf_count_ == 0) continue;
+    json& perf = j["perfPerKey"];
+    for (size_t k = 0; k < PERF_EVENT_COUNT; k++) {
+      PerfEvent e = static_cast<PerfEvent>(k);
+      if (PerfCounters::available(e))
+        perf[PerfCounters::name(e)] =
+            static_cast<double>(s.events_[k]) / s.perf_count_;
+    }
+    if (perf.count("cycles") && perf.count("instructions") &&
+        s.events_[0] != 0)
+      perf["ipc"] = static_cast<double>(s.events_[1]) / s.events_[0];
+  }
+  if (PerfCounters::probed()) {
+    // counted events and errors of events that could not be opened
+    json& perf = out["perfCounters"];
+    perf["events"] = json::array();
+    perf["unavailable"] = json::object();
+    for (size_t k = 0; k < PERF_EVENT_COUNT; k++) {
+      PerfEvent e = static_cast<PerfEvent>(k);
+      if (PerfCounters::available(e))
+        perf["events"].push_back(PerfCounters::name(e));
+      else
+        perf["unavailable"][PerfCounters::name(e)] = PerfCounters::error(e);
+    }
   }
-  return ss.str();
+  return out;
+}
+
+/// \brief Stream buffer discarding its output.
+class NullBuffer : public std::streambuf {
+ protected:
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+  int overflow(int c) override { return traits_type::not_eof(c); }
+};
+
+/// \brief Command line argument of JSON job value.
+std::string batchArgument(const json& value) {
+  return (value.is_string() ? value.get<std::string>() : value.dump());
 }
 }
 
 void CommandInterpreter::execute() {
+  // stage counters are process wide, each top-level command starts from
+  // zero, jobs of batch and daemon share the pool and add to its counters
+  if (shared_pool_ == nullptr) StageStats::reset();
   if (ui_.oper_.compare(OPER_GENERATE_COIN) == 0) {
     doGenerateCoin();
   } else if (ui_.oper_.compare(OPER_GENERATE_COIN_RANDOM) == 0) {
@@ -52,8 +209,18 @@ void CommandInterpreter::execute() {
     doGenerateWalletDTS();
   } else if (ui_.oper_.compare(OPER__GENERATE_WALLET_HD) == 0) {
     doGenerateWalletHD();
+  } else if (ui_.oper_.compare(OPER_GENERATE_ADDRESSES_XPUB) == 0) {
+    doGenerateAddressesXpub();
   } else if (ui_.oper_.compare(OPER_TEST) == 0) {
     doTest();
+  } else if (ui_.oper_.compare(OPER_BATCH) == 0) {
+    doBatch();
+  } else if (ui_.oper_.compare(OPER_SERVE) == 0) {
+    doServe();
+  } else if (ui_.oper_.compare(OPER_BENCH) == 0) {
+    doBench();
+  } else if (ui_.oper_.compare(OPER_TUNE) == 0) {
+    doTune();
   } else if (ui_.oper_.compare(OPER_DEFAULT) == 0) {
     doDefault();
   } else
@@ -74,8 +241,7 @@ void CommandInterpreter::doGenerateCoin() {
     throw std::out_of_range(
         "generate-coin: salt length out of range [0, 65535]");
   SecretKey priv;
-  WarpKeyGenerator key_gen;
-  key_gen.generate(ui_.pwd_, ui_.salt_, priv);
+  warpKey(ui_.pwd_, ui_.salt_, priv);
   CoinKeyPair coin(ui_.cid_);
   coin.create(priv.data(), priv.size());
   initJSON();
@@ -94,23 +260,91 @@ void CommandInterpreter::doGenerateCoinRandom() {
   pwd_gen.init();
   auto cnt = ui_.random_.value().keys_;
   auto pwd_len = ui_.random_.value().pwd_len_;
-  std::map<std::pair<Password, Password>, CoinKeyPair> coins;
-  while (cnt > 0) {
+  if (std::pow(62.0, pwd_len) < cnt)
+    throw std::out_of_range(
+        "generate-coin-random: key count exceeds password combinations");
+  if (!isStreaming() && cnt > MAX_KEYS_JSON)
+    throw std::out_of_range(
+        "generate-coin-random: key count > 999 requires streamed output "
+        "format <ndjson | csv>");
+  bool unique_pwds = needsUniquePasswords(cnt, pwd_len);
+  if (unique_pwds && cnt > MAX_KEYS_UNIQUE)
+    throw std::out_of_range(
+        "generate-coin-random: key count > 1000000 requires longer "
+        "passwords");
+
+  ProgressMeter meter(std::cerr, cnt, ui_.progress_);
+  KeyPipeline pipeline(pool(), ui_.cid_, false, true, ui_.interleave_);
+
+  if (isStreaming()) {
+    // passwords are drawn by workers, memory use is bounded by window size
+    // unless passwords are short enough to collide, drawn passwords are
+    // then kept for duplicate filtering, at most MAX_KEYS_UNIQUE of them
+    std::mutex draw_mutex;
+    std::set<Password> drawn;
+    auto draw = [&](Password& pwd) {
+      std::lock_guard<std::mutex> lock(draw_mutex);
+      do {
+        pwd_gen.generatePassword(pwd, pwd_len);
+      } while (unique_pwds && !drawn.insert(pwd).second);
+    };
+
+    auto sink = openKeySink(cnt, KeyExportWallet::kRandom, "random", 0,
+                            OptionsOutput(0xff), "password");
+    pipeline.run(cnt,
+                 [&](uint64_t, size_t n, SecretKey* secrets, Password* pwds) {
+                   for (size_t j = 0; j < n; j++) draw(pwds[j]);
+                   std::vector<ByteView> views(pwds, pwds + n);
+                   warpKeys(views.data(), n, ui_.salt_, secrets);
+                 },
+                 [&](uint64_t i, const CoinKeyPair& coin, const Password& pwd) {
+                   sink->write(i, coin, pwd);
+                   meter.add();
+                 });
+    finishKeySink(*sink);
+    meter.finish();
+    pipeline_stats_ = pipeline.stats();
+    if (ui_.progress_) pipeline.stats().report(std::cerr);
+    if (ui_.format_ == OutputFormat::kBinary) {
+      initJSON();
+      addJSON(ui_);
+      addJSON(static_cast<const KeyExportWriter&>(*sink));
+      flushJSON();
+    }
+    return;
+  }
+
+  // draw unique passwords first, PRNG engine is not thread safe
+  std::set<Password> unique;
+  while (unique.size() < cnt) {
     Password pwd(pwd_len);
     pwd_gen.generatePassword(pwd, pwd.size());
-    WarpKeyGenerator key_gen;
-    SecretKey priv;
-    key_gen.generate(pwd, ui_.salt_, priv);
-    CoinKeyPair coin(ui_.cid_);
-    coin.create(priv.data(), priv.size());
-    std::pair<Password, Password> pair = std::make_pair(pwd, ui_.salt_);
-    auto ret = coins.emplace(std::make_pair(pair, coin));
-    if (ret.second) --cnt;
+    unique.insert(pwd);
   }
+  std::vector<Password> pwds(unique.begin(), unique.end());
+
+  // derive keys in parallel, each result has its own slot
+  KeyVect keys(pwds.size(), CoinKeyPair(ui_.cid_));
+  pipeline.run(pwds.size(),
+               [&](uint64_t first, size_t n, SecretKey* secrets, Password*) {
+                 std::vector<ByteView> views(pwds.begin() + first,
+                                             pwds.begin() + first + n);
+                 warpKeys(views.data(), n, ui_.salt_, secrets);
+               },
+               [&](uint64_t i, const CoinKeyPair& coin, const Password&) {
+                 keys[i] = coin;
+                 meter.add();
+               });
+  meter.finish();
+  pipeline_stats_ = pipeline.stats();
+  if (ui_.progress_) pipeline.stats().report(std::cerr);
+
+  PassWordSaltKeyMap coins;
+  for (size_t i = 0; i < pwds.size(); i++)
+    coins.emplace(std::make_pair(pwds[i], ui_.salt_), keys[i]);
   initJSON();
   addJSON(ui_);
-  addJSON(coins);
-  flushJSON();
+  flushJSON(coins);
 }
 
 void CommandInterpreter::doAttach() {
@@ -119,25 +353,24 @@ void CommandInterpreter::doAttach() {
         "attach: invalid parameters <password length | salt | address>");
 
   auto len = ui_.attach_.value().pwd_len_;
-  ByteVect pwd(len);
+  Password pwd(len);
   CoinKeyPair coin(ui_.cid_);
   CoinKeyPair challenge(ui_.cid_, false, ui_.attach_.value().address_);
-  WarpKeyGenerator key_gen;
   RandomSeedGenerator pwd_gen(SeedChar::kAll);
   pwd_gen.init();
   SecretKey secret;
   bool isFound{false};
   auto cnt(0);
-  auto start = std::chrono::system_clock::now();
+  auto start = std::chrono::steady_clock::now();
   // loop until coin address of challenge found
   do {
     pwd_gen.generatePassword(pwd, pwd.size());
-    key_gen.generate(pwd, ui_.salt_, secret);
+    warpKey(pwd, ui_.salt_, secret);
     coin.create(secret.data(), secret.size());
     isFound = coin.equals(challenge);
     cnt++;
   } while (!isFound);
-  auto stop = std::chrono::system_clock::now();
+  auto stop = std::chrono::steady_clock::now();
   auto elapsed = stop - start;
   auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
   auto combination(pow(62, pwd.size()));
@@ -156,76 +389,775 @@ void CommandInterpreter::doGenerateWalletDTS() {
         "generate-wallet-deterministic-simple: invalid parameters <password  | "
         "salt | magic-number "
         "| key-count | is-watch-only>");
-  // generate root key
-  WarpKeyGenerator key_gen;
+  // generate root key, with cache only a cache miss runs the KDF
   SecretKey root;
-  key_gen.generate(ui_.pwd_, ui_.salt_, root);
+  bool cached{false};
+  if (!ui_.root_cache_.empty()) {
+    RootKeyCache cache(ui_.root_cache_);
+    cached = cache.load(ui_.pwd_, ui_.salt_, ui_.cid_, root);
+    if (!cached) {
+      warpKey(ui_.pwd_, ui_.salt_, root);
+      cache.store(ui_.pwd_, ui_.salt_, ui_.cid_, root);
+    }
+  } else {
+    warpKey(ui_.pwd_, ui_.salt_, root);
+  }
 
+  // children [from, from + count) of the wallet
   unsigned long long idx = ui_.dts_wallet_.value().magic_;
-  unsigned long long cnt = ui_.dts_wallet_.value().keys_ + idx;
+  idx += ui_.dts_wallet_.value().from_;
+  unsigned long long cnt = ui_.dts_wallet_.value().keys_;
+  ProgressMeter meter(std::cerr, cnt, ui_.progress_);
   std::string root_hex = byte2HexString(root.data(), root.size());
-  KeyVect coins;
-  coins.clear();
-  for (unsigned long long i = idx; i < cnt; i++) {
+  WipeOnExit wipe_root_hex(root_hex);
+
+  OptionsOutput options = OptionsOutput(0xff);
+  if (ui_.dts_wallet_.value().is_watch_only_) {
+    options.reset(OptionsOutputEnum::kKeysPrivKey);
+    options.reset(OptionsOutputEnum::kRootKey);
+  }
+
+  auto derive = [&](unsigned long long first, size_t n, SecretKey* secrets) {
     // simple deterministic algorithm for child creation
     // child = string(root.hex) + string(i)
-    ByteVect child;
-    child.reserve(root_hex.size());
-    child.insert(child.begin(), root_hex.begin(), root_hex.end());
-    std::string add = std::to_string(i);
-    child.reserve(child.size() + add.size());
-    child.insert(child.end(), add.begin(), add.end());
-
-    // generate new key using child as password
-    SecretKey secret;
-    key_gen.generate(child, ui_.salt_, secret);
-    CoinKeyPair coin(ui_.cid_);
-    coin.create(secret.data(), secret.size());
-    coins.insert(std::end(coins), coin);
-  }
+    std::vector<SecureBytes> children(n);
+    for (size_t j = 0; j < n; j++) {
+      std::string add = std::to_string(first + j);
+      children[j].reserve(root_hex.size() + add.size());
+      children[j].insert(children[j].end(), root_hex.begin(), root_hex.end());
+      children[j].insert(children[j].end(), add.begin(), add.end());
+    }
+
+    // generate new keys using children as passwords
+    std::vector<ByteView> views(children.begin(), children.end());
+    warpKeys(views.data(), n, ui_.salt_, secrets);
+  };
+
+  auto addWallet = [&]() {
+    initJSON();
+    addJSON(ui_);
+    addJSON(ui_.dts_wallet_.value());
+    if (!ui_.root_cache_.empty())
+      out_["_user"]["wallet"]["rootCache"] = (cached ? "hit" : "miss");
+  };
+
+  // records are written in child index order as soon as they are ready
+  std::string head;
   ui_.dts_wallet_.value().root_ = root_hex;
-  initJSON();
-  addJSON(ui_);
-  addJSON(ui_.dts_wallet_.value());
+  WipeOnExit wipe_root(ui_.dts_wallet_.value().root_);
+  if (ui_.format_ == OutputFormat::kJson) {
+    addWallet();
+    head = out_.dump(2);
+    out_.clear();
+  }
+  bool v2 = (ui_.dts_wallet_.value().version_ == 2);
+  auto sink = openKeySink(cnt, KeyExportWallet::kDeterministicSimple,
+                          dtsType(ui_.dts_wallet_.value()), idx, options, "",
+                          head, v2);
+  bool watch_only = ui_.dts_wallet_.value().is_watch_only_;
+  PipelineStats stats{0, {}, 0, 0};
+  if (v2) {
+    // children are derived in blocks sharing one field inversion
+    size_t window = 2 * pool().size();
+    size_t blocks = (cnt + DTS_BLOCK_SIZE - 1) / DTS_BLOCK_SIZE;
+    std::vector<SecretKeys> secrets(window, SecretKeys(DTS_BLOCK_SIZE));
+    std::vector<std::vector<Secp256k1::PointJ>> sums(
+        window, std::vector<Secp256k1::PointJ>(DTS_BLOCK_SIZE));
+    std::vector<std::vector<Secp256k1::Point>> points(
+        window, std::vector<Secp256k1::Point>(DTS_BLOCK_SIZE));
+    std::vector<KeyVect> coins(window);
+    std::vector<std::vector<uint64_t>> indexes(window);
+    pool().orderedFor(
+        0, blocks, window,
+        [&](size_t b, size_t slot) {
+          uint64_t begin = b * DTS_BLOCK_SIZE;
+          size_t count = std::min<uint64_t>(cnt - begin, DTS_BLOCK_SIZE);
+          HmacSha256 mac(root.data(), root.size());
+          indexes[slot].clear();
+          size_t n = 0;
+          for (size_t j = 0; j < count; j++) {
+            if (!dtsChildSecret(mac, idx + begin + j, secrets[slot][n].data()))
+              continue;
+            sums[slot][n] = Secp256k1::multiplyG(secrets[slot][n].data());
+            indexes[slot].push_back(idx + begin + j);
+            n++;
+          }
+          Secp256k1::toAffine(sums[slot].data(), points[slot].data(), n);
+          coins[slot].clear();
+          uint8_t pub[33];
+          for (size_t j = 0; j < n; j++) {
+            Secp256k1::serialize(points[slot][j], true, pub);
+            coins[slot].push_back(encodeKeyPair(
+                ui_.cid_, pub, sizeof(pub),
+                watch_only ? nullptr : secrets[slot][j].data()));
+          }
+        },
+        [&](size_t b, size_t slot) {
+          for (size_t j = 0; j < coins[slot].size(); j++)
+            sink->write(indexes[slot][j], coins[slot][j]);
+          meter.add(std::min<uint64_t>(cnt - b * DTS_BLOCK_SIZE,
+                                       DTS_BLOCK_SIZE));
+        });
+  } else {
+    // KDF, EC and output of children overlap in pipeline stages
+    KeyPipeline pipeline(pool(), ui_.cid_, false, !watch_only,
+                         ui_.interleave_);
+    pipeline.run(cnt,
+                 [&](uint64_t first, size_t n, SecretKey* secrets, Password*) {
+                   derive(idx + first, n, secrets);
+                 },
+                 [&](uint64_t k, const CoinKeyPair& coin, const Password&) {
+                   sink->write(idx + k, coin);
+                   meter.add();
+                 });
+    stats = pipeline.stats();
+    pipeline_stats_ = stats;
+  }
+  finishKeySink(*sink);
+  meter.finish();
+  if (ui_.progress_ && !v2) stats.report(std::cerr);
+  if (ui_.format_ == OutputFormat::kBinary) {
+    addWallet();
+    addJSON(static_cast<const KeyExportWriter&>(*sink));
+    flushJSON();
+  }
+}
+
+void CommandInterpreter::doGenerateWalletHD() {
+  if (!ui_.hd_wallet || !ui_.hd_wallet.value())
+    throw std::invalid_argument(
+        "generate-wallet-deterministic-bib32: invalid parameters "
+        "<password | salt | ext-keys | int-keys | is-watch-only>");
+  // Warp key is the seed of master node, it is the only expensive step
+  SecretKey seed;
+  warpKey(ui_.pwd_, ui_.salt_, seed);
+  ExtendedKey master = HDWallet::master(seed.data(), seed.size());
+  secureWipe(seed.data(), seed.size());
+
+  // BIP44 account m/44'/coin'/0', chains are derived from account key and
+  // from its public key in watch-only wallet
+  auto& wallet = ui_.hd_wallet.value();
+  DerivationPath path = HDWallet::accountPath(ui_.cid_);
+  ExtendedKey account = HDWallet::derive(master, path);
+  wallet.account_path_ = HDWallet::formatPath(path);
+  wallet.account_xpub_ =
+      HDWallet::serialize(HDWallet::neuter(account), ui_.cid_);
+  wallet.account_xprv_.clear();
   OptionsOutput options = OptionsOutput(0xff);
-  if (ui_.dts_wallet_.value().is_watch_only_) {
+  if (wallet.is_watch_only_) {
+    account = HDWallet::neuter(account);
     options.reset(OptionsOutputEnum::kKeysPrivKey);
     options.reset(OptionsOutputEnum::kRootKey);
+  } else {
+    wallet.account_xprv_ = HDWallet::serialize(account, ui_.cid_);
+  }
+  WipeOnExit wipe_xprv(wallet.account_xprv_);
+
+  // keys are derived in blocks of one chain, chain node is derived once by
+  // cache and each block only does leaf steps, external chain goes first
+  struct Block {
+    uint32_t chain_;
+    uint32_t begin_;
+    uint32_t end_;
+  };
+  std::vector<Block> blocks;
+  for (uint32_t chain = 0; chain < 2; chain++) {
+    uint32_t n = (chain == 0 ? wallet.external_keys_ : wallet.internal_keys_);
+    for (uint32_t k = 0; k < n; k += HD_BLOCK_SIZE)
+      blocks.push_back({chain, k, std::min(n, k + HD_BLOCK_SIZE)});
+  }
+  DerivationCache cache(account);
+  uint64_t cnt = uint64_t(wallet.external_keys_) + wallet.internal_keys_;
+  ProgressMeter meter(std::cerr, cnt, ui_.progress_);
+
+  std::string head;
+  if (ui_.format_ == OutputFormat::kJson) {
+    initJSON();
+    addJSON(ui_);
+    addJSON(wallet);
+    head = out_.dump(2);
+    out_.clear();
+  }
+  auto sink =
+      openKeySink(cnt, KeyExportWallet::kDeterministicHD,
+                  "deterministic-hierarchical-bip-0032", 0, options, "path",
+                  head, true);
+  size_t window = 2 * pool().size();
+  std::vector<std::vector<ExtendedKey>> keys(window);
+  std::vector<KeyVect> coins(window);
+  std::vector<std::vector<ByteVect>> paths(window);
+  pool().orderedFor(
+      0, blocks.size(), window,
+      [&](size_t b, size_t slot) {
+        const Block& blk = blocks[b];
+        cache.range({blk.chain_}, blk.begin_, blk.end_, keys[slot]);
+        std::string prefix =
+            wallet.account_path_ + '/' + std::to_string(blk.chain_) + '/';
+        coins[slot].clear();
+        paths[slot].clear();
+        for (size_t j = 0; j < keys[slot].size(); j++) {
+          coins[slot].push_back(
+              HDWallet::coinKeyPair(keys[slot][j], ui_.cid_));
+          std::string s = prefix + std::to_string(blk.begin_ + j);
+          paths[slot].emplace_back(s.begin(), s.end());
+        }
+      },
+      [&](size_t b, size_t slot) {
+        // record index is chain << 32 | child
+        const Block& blk = blocks[b];
+        for (size_t j = 0; j < coins[slot].size(); j++)
+          sink->write(uint64_t(blk.chain_) << 32 | (blk.begin_ + j),
+                      coins[slot][j], paths[slot][j]);
+        meter.add(coins[slot].size());
+      });
+  finishKeySink(*sink);
+  meter.finish();
+  if (ui_.format_ == OutputFormat::kBinary) {
+    initJSON();
+    addJSON(ui_);
+    addJSON(wallet);
+    addJSON(static_cast<const KeyExportWriter&>(*sink));
+    flushJSON();
   }
-  addJSON(coins, options);
-  flushJSON();
 }
 
-void CommandInterpreter::doGenerateWalletHD() {
-  throw std::domain_error(
-      "generate-wallet-deterministic-hierachical-bib32 command not "
-      "implemented");
-  /*
-      SecretKey seed;
-      WarpKeyGenerator key_gen;
-      key_gen.generate(pwd, salt, seed);
-      std::string hex(byte2HexString(seed.data(), seed.size()));
-
-      // init master node with the seed
-
-      // init account
-
-      // generate wallet chains
-      int chains = (internal_address_cnt == 0 ? 1 : 2);
-      for (auto j = 0; j < chains; j++) {
-        // generate external/internal addresses
-        int addr_cnt = (j == 0 ? external_address_cnt : internal_address_cnt);
-        for (auto k = 0; k < addr_cnt; k++) {
+void CommandInterpreter::doGenerateAddressesXpub() {
+  if (!ui_.xpub_watch_ || !ui_.xpub_watch_.value())
+    throw std::invalid_argument(
+        "generate-addresses-xpub: invalid parameters <extended-public-key | "
+        "chain | first-index | key-count>");
+  // only public derivation is done, private extended key is neutered
+  auto& watch = ui_.xpub_watch_.value();
+  ExtendedKey parent =
+      HDWallet::neuter(HDWallet::parse(watch.xpub_, ui_.cid_));
+  watch.xpub_ = HDWallet::serialize(parent, ui_.cid_);
+  ExtendedKey chain = HDWallet::derive(parent, watch.chain_);
+  OptionsOutput options = OptionsOutput(0xff);
+  options.reset(OptionsOutputEnum::kKeysPrivKey);
+  options.reset(OptionsOutputEnum::kRootKey);
+
+  uint32_t first = watch.first_;
+  uint32_t end = first + watch.keys_;
+  size_t blocks = (watch.keys_ + XPUB_BLOCK_SIZE - 1) / XPUB_BLOCK_SIZE;
+  ProgressMeter meter(std::cerr, watch.keys_, ui_.progress_);
+
+  std::string head;
+  if (ui_.format_ == OutputFormat::kJson) {
+    initJSON();
+    addJSON(ui_);
+    addJSON(watch);
+    head = out_.dump(2);
+    out_.clear();
+  }
+  auto sink = openKeySink(watch.keys_, KeyExportWallet::kDeterministicHD,
+                          "deterministic-hierarchical-xpub", first, options,
+                          "", head, true);
+  size_t window = 2 * pool().size();
+  std::vector<std::vector<Secp256k1::Point>> points(
+      window, std::vector<Secp256k1::Point>(XPUB_BLOCK_SIZE));
+  std::vector<KeyVect> coins(window);
+  pool().orderedFor(
+      0, blocks, window,
+      [&](size_t b, size_t slot) {
+        uint32_t begin = first + static_cast<uint32_t>(b) * XPUB_BLOCK_SIZE;
+        uint32_t n = std::min(end - begin, XPUB_BLOCK_SIZE);
+        HDWallet::derivePublicKeys(chain, begin, n, points[slot].data());
+        coins[slot].clear();
+        uint8_t pub[33];
+        for (uint32_t j = 0; j < n; j++) {
+          Secp256k1::serialize(points[slot][j], true, pub);
+          coins[slot].push_back(encodeKeyPair(ui_.cid_, pub, sizeof(pub)));
         }
-        for (auto k = 0; k < addr_cnt; k++) {
+      },
+      [&](size_t b, size_t slot) {
+        // record index is chain << 32 | child as in HD wallet
+        uint32_t begin = first + static_cast<uint32_t>(b) * XPUB_BLOCK_SIZE;
+        for (size_t j = 0; j < coins[slot].size(); j++)
+          sink->write(uint64_t(watch.chain_) << 32 | (begin + j),
+                      coins[slot][j]);
+        meter.add(coins[slot].size());
+      });
+  finishKeySink(*sink);
+  meter.finish();
+  if (ui_.format_ == OutputFormat::kBinary) {
+    initJSON();
+    addJSON(ui_);
+    addJSON(watch);
+    addJSON(static_cast<const KeyExportWriter&>(*sink));
+    flushJSON();
+  }
+}
+
+void CommandInterpreter::doTest() {
+  if (ui_.test_specs_.empty())
+    throw std::invalid_argument("test: invalid parameters <spec files>");
+  std::vector<TestVector> vectors = loadTestVectors(ui_.test_specs_);
+  if (vectors.empty()) throw std::invalid_argument("test: no test vectors");
+
+  // vectors run in parallel, each result has its own slot
+  std::vector<TestResult> results(vectors.size());
+  ProgressMeter meter(std::cerr, vectors.size(), ui_.progress_);
+  auto start = std::chrono::steady_clock::now();
+  pool().parallelFor(0, vectors.size(), [&](size_t i) {
+    try {
+      results[i] = runTestVector(vectors[i], cancel_);
+    } catch (OperationCancelled&) {
+      throw;
+    } catch (std::exception& e) {
+      results[i].error_ = e.what();
+    }
+    meter.add();
+  });
+  meter.finish();
+  auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  initJSON();
+  out_["_user"]["command"] = ui_.oper_;
+  size_t passed{0};
+  for (size_t i = 0; i < vectors.size(); i++) {
+    addJSON(vectors[i], results[i]);
+    if (results[i].passed()) passed++;
+  }
+  out_["summary"]["vectors"] = vectors.size();
+  out_["summary"]["passed"] = passed;
+  out_["summary"]["failed"] = vectors.size() - passed;
+  out_["summary"]["threads"] = pool().size();
+  out_["summary"]["ms"] = msec.count();
+  flushJSON();
+}
+
+void CommandInterpreter::doBatch() {
+  if (!ui_.batch_ || !ui_.batch_.value())
+    throw std::invalid_argument("batch: invalid command parameters <jobs-file>");
+  const auto& batch = ui_.batch_.value();
+  std::ifstream file;
+  std::istream* in = &std::cin;
+  if (batch.file_ != "-") {
+    file.open(batch.file_);
+    if (!file)
+      throw std::runtime_error("batch: cannot open jobs file " + batch.file_);
+    in = &file;
+  }
+
+  // workers and their scrypt memory stay warm for all jobs
+  ThreadPool& workers = pool();
+  WarpKeyGenerator::warmUp(static_cast<unsigned int>(workers.size()));
+
+  // jobs are read while earlier ones run, at most 'window' in flight
+  const size_t window = 2 * workers.size();
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t running{0};
+  uint64_t next{0};
+  std::map<uint64_t, std::string> ready;
+  auto emit = [&](uint64_t seq, std::string&& result) {
+    if (batch.ordered_) {
+      ready.emplace(seq, std::move(result));
+      for (auto it = ready.begin(); it != ready.end() && it->first == next;
+           it = ready.erase(it), next++)
+        ui_.out_ << it->second << '\n';
+    } else {
+      ui_.out_ << result << '\n';
+    }
+    ui_.out_.flush();
+  };
+
+  std::string line;
+  uint64_t seq{0};
+  uint64_t line_no{0};
+  while (std::getline(*in, line)) {
+    line_no++;
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&] { return running < window; });
+      running++;
+    }
+    auto received = std::chrono::steady_clock::now();
+    workers.submit([&, line, seq, line_no, received] {
+      std::string result = runBatchJob(line, line_no, received);
+      std::lock_guard<std::mutex> lock(mutex);
+      emit(seq, std::move(result));
+      running--;
+      done.notify_all();
+    });
+    seq++;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return running == 0; });
+  // stage timing of all jobs follows their results
+  if (ui_.stats_)
+    ui_.out_ << json{{"stats", stageJSON(StageStats::summary())}}.dump()
+             << std::endl;
+}
+
+void CommandInterpreter::doServe() {
+  if (!ui_.serve_ || !ui_.serve_.value())
+    throw std::invalid_argument(
+        "serve: invalid command parameters <socket-path>");
+  const auto& serve = ui_.serve_.value();
+
+  // steady state job latency is key derivation only
+  ThreadPool& workers = pool();
+  WarpKeyGenerator::warmUp(static_cast<unsigned int>(workers.size()));
+
+  JobServer server(serve.socket_, workers, serve.max_queue_,
+                   [this](const std::string& line, uint64_t seq,
+                          JobServer::Clock::time_point received,
+                          const CancelToken& cancel) {
+                     return runBatchJob(line, seq, received, &cancel);
+                   });
+  std::cerr << "serve: listening on " << serve.socket_ << ", " << workers.size()
+            << " workers";
+  if (ui_.tuned_) std::cerr << ", profile " << ui_.profile_;
+  std::cerr << std::endl;
+  server.run();
+
+  initJSON();
+  addJSON(ui_);
+  out_["served"] = server.served();
+  out_["rejected"] = server.rejected();
+  flushJSON();
+}
+
+void CommandInterpreter::doBench() {
+  if (!ui_.bench_ || !ui_.bench_.value())
+    throw std::invalid_argument(
+        "bench: invalid command parameters <key-count [random | dts ...]>");
+  const auto& bench = ui_.bench_.value();
+  std::vector<unsigned int> threads = bench.threads_;
+  if (threads.empty()) {
+    unsigned int cores = std::max(1U, std::thread::hardware_concurrency());
+    for (unsigned int t = 1; t < cores; t *= 2) threads.push_back(t);
+    threads.push_back(cores);
+  }
+  const std::string keys = std::to_string(bench.keys_);
+  const std::string network = std::to_string(static_cast<int>(ui_.cid_));
+
+  initJSON();
+  out_["_user"]["command"] = ui_.oper_;
+  out_["_user"]["keyCount"] = bench.keys_;
+  out_["machine"]["cores"] = std::thread::hardware_concurrency();
+  out_["machine"]["scryptMemoryMB"] = WarpKeyGenerator::kScryptMemory >> 20;
+  out_["results"] = json::array();
+
+  // every configuration runs the real command with streamed output, scrypt
+  // memory is mapped before measuring as in batch and daemon
+  for (auto& path : bench.paths_)
+    for (auto& huge : bench.huge_pages_)
+      for (auto interleave : bench.interleave_)
+        for (auto t : threads) {
+          json r;
+          r["path"] = path;
+          r["threads"] = t;
+          r["interleave"] = interleave;
+          r["hugePages"] = huge;
+          try {
+            std::vector<std::string> args{
+                "bench",         "-n", network, "-t", std::to_string(t),
+                "--interleave",  std::to_string(interleave), "-f", "ndjson",
+                "-c"};
+            if (path == "random")
+              args.insert(args.end(), {"2", "-p", "16", "bench", keys});
+            else
+              args.insert(args.end(),
+                          {"4", "-p", "bench", "bench", "0", keys, "0"});
+            std::vector<char*> argv;
+            for (auto& a : args) argv.push_back(&a[0]);
+            // key records are discarded, neither kept in memory nor counted
+            // in peak RSS
+            NullBuffer discard;
+            std::ostream out(&discard);
+            UserInterface ui(out);
+            if (!ui.parse(static_cast<int>(argv.size()), argv.data()))
+              throw std::invalid_argument("bench: invalid configuration");
+
+            WarpKeyGenerator::coolDown();
+            WarpKeyGenerator::setHugePages(huge);
+            CommandInterpreter cmd(ui, nullptr, cancel_);
+            size_t workers = cmd.pool().size();
+            WarpKeyGenerator::warmUp(
+                static_cast<unsigned int>(workers * interleave));
+            bool has_rss = resetPeakRss();
+            cmd.execute();
+
+            const PipelineStats& stats = cmd.pipelineStats();
+            double rate = (stats.wall_ms_ > 0
+                               ? 1000.0 * bench.keys_ / stats.wall_ms_
+                               : 0.0);
+            r["workers"] = workers;
+            r["ms"] = stats.wall_ms_;
+            r["keysPerSecond"] = rate;
+            r["latencyP50Ms"] = stats.latency_p50_ms_;
+            r["latencyP99Ms"] = stats.latency_p99_ms_;
+            if (has_rss) r["peakRssMB"] = peakRss() / double(1 << 20);
+            // derived from key rate, not measured: ROMix writes V once and
+            // reads it once, key of DTS root is derived before the pipeline
+            // and is not counted
+            r["scryptBandwidthMBpsEstimated"] =
+                rate * 2 * WarpKeyGenerator::kScryptMemory / 1e6;
+          } catch (OperationCancelled&) {
+            throw;
+          } catch (std::exception& e) {
+            r["error"] = e.what();
+          }
+          std::cerr << "bench: " << r.dump() << std::endl;
+          if (r.count("keysPerSecond") > 0) {
+            json& best = out_["best"][path];
+            if (best.is_null() || r["keysPerSecond"].get<double>() >
+                                      best["keysPerSecond"].get<double>())
+              best = r;
+          }
+          out_["results"].push_back(r);
         }
+
+  // later commands of process use memory of its own settings
+  WarpKeyGenerator::coolDown();
+  WarpKeyGenerator::setHugePages(ui_.huge_pages_);
+  flushJSON();
+}
+
+void CommandInterpreter::doTune() {
+  MachineProfile profile(ui_.profile_);
+  const unsigned int cores = profile.machine_.cores_ ? profile.machine_.cores_
+                                                     : 1;
+  const SecureBytes salt{'t', 'u', 'n', 'e'};
+  json runs = json::array();
+
+  // one round of 'threads' workers each deriving 'lanes' keys, memory is
+  // mapped and prefaulted before timing as in batch and daemon
+  auto measure = [&](unsigned int threads, unsigned int lanes,
+                     const std::string& huge) {
+    WarpKeyGenerator::coolDown();
+    WarpKeyGenerator::setHugePages(huge);
+    ThreadPool workers(threads);
+    WarpKeyGenerator::warmUp(threads * lanes);
+    auto start = std::chrono::steady_clock::now();
+    workers.parallelFor(0, threads, [&](size_t w) {
+      std::vector<SecureBytes> pwds(lanes);
+      std::vector<ByteView> views;
+      for (unsigned int j = 0; j < lanes; j++) {
+        std::string s = "tune-" + std::to_string(w) + '-' + std::to_string(j);
+        pwds[j].assign(s.begin(), s.end());
+        views.emplace_back(pwds[j]);
       }
-  */
+      SecretKeys keys(lanes);
+      warpKeys(views.data(), lanes, salt, keys.data());
+    });
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    double rate = 1000.0 * threads * lanes / ms;
+    json r{{"scryptKernel", WarpKeyGenerator::kernel()},
+           {"threads", threads},
+           {"interleave", lanes},
+           {"hugePages", huge},
+           {"keysPerSecond", rate}};
+    std::cerr << "tune: " << r.dump() << std::endl;
+    runs.push_back(r);
+    return rate;
+  };
+
+  // kernel is compute bound, it is selected on one thread
+  double best{0};
+  for (auto& k : WarpKeyGenerator::kernels()) {
+    WarpKeyGenerator::setKernel(k);
+    double rate = measure(1, 1, "default");
+    if (rate > best) {
+      best = rate;
+      profile.kernel_ = k;
+    }
+  }
+  WarpKeyGenerator::setKernel(profile.kernel_);
+
+  // threads are doubled while throughput grows, on most machines memory
+  // bandwidth saturates before all cores are used
+  best = 0;
+  std::vector<unsigned int> threads;
+  for (unsigned int t = 1; t < cores; t *= 2) threads.push_back(t);
+  threads.push_back(cores);
+  for (auto t : threads) {
+    for (unsigned int lanes = 1; lanes <= 4; lanes *= 2) {
+      if (WarpKeyGenerator::concurrency(t, lanes) < t) break;
+      double rate = measure(t, lanes, "default");
+      if (rate > best) {
+        best = rate;
+        profile.threads_ = t;
+        profile.interleave_ = lanes;
+      }
+    }
+    if (profile.threads_ != t) break;
+  }
+  if (best == 0) throw std::runtime_error("tune: not enough memory");
+
+  // huge pages only when they pay off
+  profile.huge_pages_ = "default";
+  for (auto huge : {"on", "off"}) {
+    double rate = measure(profile.threads_, profile.interleave_, huge);
+    if (rate > 1.02 * best) {
+      best = rate;
+      profile.huge_pages_ = huge;
+    }
+  }
+  profile.keys_per_second_ = best;
+  WarpKeyGenerator::coolDown();
+  WarpKeyGenerator::setHugePages(ui_.huge_pages_);
+  profile.store();
+
+  initJSON();
+  out_["_user"]["command"] = ui_.oper_;
+  out_["calibration"] = runs;
+  out_["profile"]["path"] = profile.path();
+  out_["profile"]["machine"] = {{"host", profile.machine_.host_},
+                                {"cpu", profile.machine_.cpu_},
+                                {"cores", profile.machine_.cores_},
+                                {"memoryMB", profile.machine_.memory_mb_}};
+  out_["profile"]["threads"] = profile.threads_;
+  out_["profile"]["interleave"] = profile.interleave_;
+  out_["profile"]["scryptKernel"] = profile.kernel_;
+  out_["profile"]["hugePages"] = profile.huge_pages_;
+  out_["profile"]["keysPerSecond"] = profile.keys_per_second_;
+  flushJSON();
 }
 
-void CommandInterpreter::doTest() {
-  throw std::domain_error(
-      "verification-against-test-vectors command not implemented");
+std::string CommandInterpreter::runBatchJob(
+    const std::string& line, uint64_t line_no,
+    std::chrono::steady_clock::time_point received,
+    const CancelToken* cancel) {
+  // jobs without id are identified by line number
+  json record;
+  record["id"] = line_no;
+  try {
+    json job = json::parse(line);
+    if (!job.is_object())
+      throw std::invalid_argument("batch: job is not JSON object");
+    if (job.count("id") > 0) record["id"] = job["id"];
+    if (job.count("command") == 0)
+      throw std::invalid_argument("batch: job command missing");
+
+    // job deadline counts from the time job was received
+    unsigned int deadline_ms = ui_.deadline_ms_;
+    if (job.count("deadline_ms") > 0)
+      deadline_ms = job["deadline_ms"].get<unsigned int>();
+    CancelToken token(deadline_ms == 0
+                          ? CancelToken::Clock::time_point::max()
+                          : received + std::chrono::milliseconds(deadline_ms),
+                      cancel);
+    token.check();
+
+    // options of job are parsed as command line, passphrase, salt and
+    // parameters are taken as they are, so values starting with '-' are not
+    // mistaken for options
+    std::string network = std::to_string(static_cast<int>(ui_.cid_));
+    if (job.count("network") > 0) network = batchArgument(job["network"]);
+    UserArguments options;
+    if (job.count("options") > 0)
+      for (auto& o : job["options"]) options.push_back(batchArgument(o));
+    UserArguments params;
+    if (job.count("passphrase") > 0)
+      params.push_back(batchArgument(job["passphrase"]));
+    if (job.count("salt") > 0) params.push_back(batchArgument(job["salt"]));
+    if (job.count("params") > 0)
+      for (auto& p : job["params"]) params.push_back(batchArgument(p));
+
+    std::ostringstream out;
+    UserInterface ui(out);
+    auto wipe = [&params] {
+      for (auto& p : params) secureWipe(&p[0], p.size());
+    };
+    bool parsed{false};
+    try {
+      parsed = ui.parseJob(network, batchCommand(job["command"]), options,
+                           params, ui_.tuned_);
+    } catch (std::exception&) {
+      wipe();
+      throw;
+    }
+    wipe();
+    if (!parsed) throw std::invalid_argument("batch: invalid job parameters");
+    // concurrent jobs cannot be told apart in stage counters, stats are
+    // reported for the whole batch or daemon run only
+    ui.stats_ = false;
+    ui.perf_counters_ = false;
+    CommandInterpreter cmd(ui, &pool(), &token);
+    cmd.execute();
+    // key lists are written into job stream, other results into result()
+    std::string text = out.str() + cmd.result().str();
+    try {
+      record["result"] = json::parse(text);
+    } catch (std::exception&) {
+      record["result"] = text;
+    }
+  } catch (std::exception& e) {
+    record["error"] = e.what();
+  }
+  return record.dump();
+}
+
+void CommandInterpreter::warpKey(ByteView pwd, ByteView salt, SecretKey& out) {
+  WarpKeyGenerator key_gen;
+  switch (key_gen.generate(pwd, salt, out, cancel_)) {
+    case WarpKeyGenerator::kCancelled:
+      throw OperationCancelled(CancelToken::Status::kCancelled);
+    case WarpKeyGenerator::kTimeout:
+      throw OperationCancelled(CancelToken::Status::kTimeout);
+    default:
+      break;
+  }
+}
+
+void CommandInterpreter::warpKeys(const ByteView* pwds, size_t count,
+                                  ByteView salt, SecretKey* outs) {
+  WarpKeyGenerator key_gen;
+  switch (key_gen.generate(pwds, count, salt, outs, cancel_)) {
+    case WarpKeyGenerator::kCancelled:
+      throw OperationCancelled(CancelToken::Status::kCancelled);
+    case WarpKeyGenerator::kTimeout:
+      throw OperationCancelled(CancelToken::Status::kTimeout);
+    default:
+      break;
+  }
+}
+
+ThreadPool& CommandInterpreter::pool() {
+  if (shared_pool_) return *shared_pool_;
+  if (!pool_)
+    pool_ = std::make_unique<ThreadPool>(
+        WarpKeyGenerator::concurrency(ui_.threads_, ui_.interleave_));
+  return *pool_;
+}
+
+std::unique_ptr<KeySink> CommandInterpreter::openKeySink(
+    uint64_t count, KeyExportWallet wallet, const std::string& type,
+    uint64_t first_index, const OptionsOutput& options,
+    const std::string& label, const std::string& head, bool compressed) {
+  if (ui_.format_ != OutputFormat::kBinary)
+    return std::make_unique<KeyWriter>(ui_.out_, ui_.format_, options,
+                                       label, head);
+  if (ui_.output_.empty())
+    throw std::invalid_argument("binary format requires output file name");
+  return std::make_unique<KeyExportWriter>(
+      ui_.output_, ui_.cid_, compressed,
+      options.test(OptionsOutputEnum::kKeysPrivKey), wallet, type, count,
+      first_index);
+}
+
+void CommandInterpreter::finishKeySink(KeySink& sink) {
+  KeyWriter* writer = dynamic_cast<KeyWriter*>(&sink);
+  if (!ui_.stats_ || writer == nullptr) return sink.finish();
+  // binary export gets stats in its JSON summary, csv on stderr
+  json stats;
+  stats["stats"] = stageJSON(StageStats::summary());
+  if (ui_.format_ == OutputFormat::kJson) {
+    std::string doc = stats.dump(2);
+    writer->finish(doc.substr(2, doc.size() - 4));
+  } else if (ui_.format_ == OutputFormat::kNdJson) {
+    writer->finish(stats.dump());
+  } else {
+    writer->finish();
+    std::cerr << stats.dump() << std::endl;
+  }
 }
 
 void CommandInterpreter::initJSON() {
@@ -238,10 +1170,30 @@ void CommandInterpreter::initJSON() {
 }
 
 void CommandInterpreter::flushJSON() {
+  if (ui_.stats_) addJSON(StageStats::summary());
   result_ << std::setw(2) << out_ << std::endl;
   out_.clear();
 }
 
+void CommandInterpreter::flushJSON(const KeyVect& coins,
+                                   const OptionsOutput& options) {
+  if (ui_.stats_) addJSON(StageStats::summary());
+  KeyWriter writer(result_, OutputFormat::kJson, options, "", out_.dump(2));
+  out_.clear();
+  for (size_t i = 0; i < coins.size(); i++) writer.write(i, coins[i]);
+  writer.finish();
+}
+
+void CommandInterpreter::flushJSON(const PassWordSaltKeyMap& coins) {
+  if (ui_.stats_) addJSON(StageStats::summary());
+  KeyWriter writer(result_, OutputFormat::kJson, OptionsOutput(0xff),
+                   "password", out_.dump(2));
+  out_.clear();
+  uint64_t i{0};
+  for (auto& c : coins) writer.write(i++, c.second, c.first.first);
+  writer.finish();
+}
+
 void CommandInterpreter::addJSON(const UserInterface& ui) {
   out_["_user"]["command"] = ui.oper_;
   out_["_user"]["network"] = ui.cid_;
@@ -250,8 +1202,9 @@ void CommandInterpreter::addJSON(const UserInterface& ui) {
 }
 
 void CommandInterpreter::addJSON(const UserInterface::WalletDTS& wallet) {
-  out_["_user"]["wallet"]["_type"] = "deterministic-simple";
+  out_["_user"]["wallet"]["_type"] = dtsType(wallet);
   out_["_user"]["wallet"]["keyCount"] = wallet.keys_;
+  if (wallet.from_ != 0) out_["_user"]["wallet"]["keyFrom"] = wallet.from_;
   out_["_user"]["wallet"]["keyRoot"] = wallet.root_;
   out_["_user"]["wallet"]["magic"] = wallet.magic_;
   out_["_user"]["wallet"]["watchOnly"] = wallet.is_watch_only_;
@@ -259,14 +1212,27 @@ void CommandInterpreter::addJSON(const UserInterface::WalletDTS& wallet) {
 
 void CommandInterpreter::addJSON(const UserInterface::WalletHD& wallet) {
   out_["_user"]["wallet"]["_type"] = "deterministic-hierarchical-bip-0032";
+  out_["_user"]["wallet"]["accountPath"] = wallet.account_path_;
+  out_["_user"]["wallet"]["accountXpub"] = wallet.account_xpub_;
+  if (!wallet.account_xprv_.empty())
+    out_["_user"]["wallet"]["accountXprv"] = wallet.account_xprv_;
   out_["_user"]["wallet"]["extKeyCount"] = wallet.external_keys_;
   out_["_user"]["wallet"]["intKeyCount"] = wallet.internal_keys_;
   out_["_user"]["wallet"]["watchOnly"] = wallet.is_watch_only_;
 }
 
+void CommandInterpreter::addJSON(const UserInterface::WatchXpub& watch) {
+  out_["_user"]["wallet"]["_type"] = "deterministic-hierarchical-bip-0032";
+  out_["_user"]["wallet"]["accountXpub"] = watch.xpub_;
+  out_["_user"]["wallet"]["chain"] = watch.chain_;
+  out_["_user"]["wallet"]["firstIndex"] = watch.first_;
+  out_["_user"]["wallet"]["keyCount"] = watch.keys_;
+  out_["_user"]["wallet"]["watchOnly"] = true;
+}
+
 void CommandInterpreter::addJSON(const UserInterface& ui,
                                  const UserInterface::Attach& attach,
-                                 const ByteVect& pwd) {
+                                 const Password& pwd) {
   out_["_user"]["command"] = ui.oper_;
   out_["_user"]["network"] = ui.cid_;
   if (ui.salt_.size() > 0) {
@@ -284,57 +1250,60 @@ void CommandInterpreter::addJSON(const UserInterface& ui,
 void CommandInterpreter::addJSON(const CoinKeyPair& coin) {
   out_["key"]["address"] = ByteVect2String(coin.address());
   std::string s = ByteVect2String(coin.publicKey());
-  for (auto& c : s) c = toupper(c);
+  std::transform(s.begin(), s.end(), s.begin(), ::toupper);
   out_["key"]["publicKeyHex"] = s;
   out_["key"]["privateKeyWif"] = ByteVect2String(coin.privateKey());
 }
 
-void CommandInterpreter::addJSON(const KeyVect& coins,
-                                 const OptionsOutput& options) {
-  json j_coins;
-  for (auto& i : coins) {
-    json o;
-    if (options.test(OptionsOutputEnum::kKeysAddress)) {
-      o["key"]["address"] = ByteVect2String(i.address());
-    }
-    if (options.test(OptionsOutputEnum::kKeysPublicKey)) {
-      std::string s = ByteVect2String(i.publicKey());
-      for (auto& c : s) c = toupper(c);
-      o["key"]["publicKeyHex"] = s;
-    }
-    if (options.test(OptionsOutputEnum::kKeysPrivKey)) {
-      o["key"]["privateKeyWif"] = ByteVect2String(i.privateKey());
-    }
-    j_coins.push_back(o);
-  }
-  out_["keys"] = j_coins;
-}
-
-void CommandInterpreter::addJSON(const PassWordSaltKeyMap& coins) {
-  json j_coins;
-  for (auto& i : coins) {
-    json o;
-    o["_password"] = ByteVect2String(i.first.first);
-    o["key"]["address"] = ByteVect2String(i.second.address());
-    o["key"]["privateKeyWif"] = ByteVect2String(i.second.privateKey());
-    std::string s = ByteVect2String(i.second.publicKey());
-    for (auto& c : s) c = toupper(c);
-    o["key"]["publicKeyHex"] = s;
-    j_coins.push_back(o);
-  }
-  out_["keys"] = j_coins;
+void CommandInterpreter::addJSON(const TestVector& vector,
+                                 const TestResult& result) {
+  json test;
+  test["spec"] = vector.spec_;
+  test["vector"] = vector.index_;
+  test["passphrase"] = ByteVect2String(vector.pwd_);
+  // checks without expected value are left out
+  auto check = [&](const char* name, TestCheck c) {
+    if (c != TestCheck::kSkipped)
+      test["checks"][name] = (c == TestCheck::kPassed ? "passed" : "failed");
+  };
+  check("scryptSeed", result.scrypt_);
+  check("pbkdf2Seed", result.pbkdf2_);
+  check("key", result.key_);
+  check("address", result.address_);
+  check("privateKeyWif", result.wif_);
+  check("publicKeyHex", result.pub_hex_);
+  if (!result.error_.empty()) test["error"] = result.error_;
+  test["scryptMs"] = std::lround(result.scrypt_ms_);
+  test["pbkdf2Ms"] = std::lround(result.pbkdf2_ms_);
+  test["ms"] = std::lround(result.ms_);
+  test["passed"] = result.passed();
+  out_["tests"].push_back(test);
+}
+
+void CommandInterpreter::addJSON(const KeyExportWriter& exporter) {
+  out_["export"]["file"] = exporter.path();
+  out_["export"]["format"] = "warpwallet-keys-binary";
+  out_["export"]["version"] = exporter.header().version_;
+  out_["export"]["records"] = exporter.header().count_;
+  out_["export"]["recordSize"] = exporter.header().record_size_;
+  out_["export"]["watchOnly"] =
+      (exporter.header().flags_ & kExportSecret) == 0;
 }
 
 void CommandInterpreter::addJSON(const std::string& name, uint64_t combination,
                                  uint64_t cnt, uint64_t ms) {
   json stat;
-  double sec(ms / 1000);
+  double sec(ms / 1000.0);
   stat["combination"] = combination;
   if (combination != 0)
     stat["coverage"] = double(cnt / double(combination)) * 100.0;
   stat["time"] = sec;
-  if (ms != 0) stat["rate"] = double(cnt / sec);
+  if (ms != 0) stat["rate"] = cnt / sec;
   stat["trial"] = cnt;
 
   out_["attach"][name] = stat;
 }
+
+void CommandInterpreter::addJSON(const std::vector<StageSummary>& stages) {
+  out_["stats"] = stageJSON(stages);
+}
@@ -21,26 +21,27 @@
 #define COMMANDINTERPRETER_H
 
 #include <bitset>
+#include <chrono>
 #include <experimental/optional>
+#include <memory>
 #include <sstream>
 #include <string>
 
+#include "CancelToken.h"
 #include "CoinKeyPair.h"
+#include "KeyExport.h"
+#include "KeyPipeline.h"
+#include "KeyWriter.h"
 #include "RandomSeedGenerator.h"
+#include "StageStats.h"
+#include "TestVectors.h"
+#include "ThreadPool.h"
 #include "UserInterface.h"
 #include "WarpKeyGenerator.h"
 #include "json.hpp"
 
 using json = nlohmann::json;
 
-enum OptionsOutputEnum : std::uint8_t {
-  kKeysAddress = 1,
-  kKeysPrivKey,
-  kKeysPublicKey,
-  kRootKey
-};
-
-using OptionsOutput = std::bitset<8>;
 using PassWordSaltKeyMap = std::map<std::pair<Password, Password>, CoinKeyPair>;
 using KeyVect = std::vector<CoinKeyPair>;
 
@@ -49,10 +50,21 @@ using KeyVect = std::vector<CoinKeyPair>;
 ///
 class CommandInterpreter {
  public:
-  explicit CommandInterpreter(UserInterface& ui) : ui_(ui) {}
+  /// \brief Interpreter of user command, bulk work runs in 'shared' pool
+  /// when given, otherwise in pool of its own. Key derivations stop when
+  /// 'cancel' fires.
+  explicit CommandInterpreter(UserInterface& ui, ThreadPool* shared = nullptr,
+                              const CancelToken* cancel = nullptr)
+      : ui_(ui),
+        shared_pool_(shared),
+        cancel_(cancel),
+        pipeline_stats_{0, {}, 0, 0} {}
 
   void execute();
 
+  /// \brief Stage counters of last pipelined key generation.
+  const PipelineStats& pipelineStats() const { return pipeline_stats_; }
+
   std::ostringstream& result() { return result_; }
 
  private:
@@ -62,23 +74,64 @@ class CommandInterpreter {
   void doGenerateCoinRandom();
   void doGenerateWalletDTS();
   void doGenerateWalletHD();
+  void doGenerateAddressesXpub();
   void doTest();
+  void doBatch();
+  void doServe();
+  void doBench();
+  void doTune();
+
+  /// \brief Runs one JSONL job line of batch or daemon, returns result line.
+  /// Job fails with timeout when its deadline passes and with cancelled when
+  /// 'cancel' fires.
+  std::string runBatchJob(const std::string& line, uint64_t line_no,
+                          std::chrono::steady_clock::time_point received,
+                          const CancelToken* cancel = nullptr);
+
+  ThreadPool& pool();
+
+  /// \brief WarpWallet key of password and salt, throws OperationCancelled
+  /// when cancel token fires.
+  void warpKey(ByteView pwd, ByteView salt, SecretKey& out);
+
+  /// \brief WarpWallet keys of 'count' passwords and salt, derived with
+  /// interleaved scrypt.
+  void warpKeys(const ByteView* pwds, size_t count, ByteView salt,
+                SecretKey* outs);
+
+  /// \brief True when key records are streamed instead of built into JSON.
+  bool isStreaming() const { return ui_.format_ != OutputFormat::kJson; }
+
+  /// \brief Opens writer of key records for selected output format.
+  std::unique_ptr<KeySink> openKeySink(uint64_t count, KeyExportWallet wallet,
+                                       const std::string& type,
+                                       uint64_t first_index,
+                                       const OptionsOutput& options,
+                                       const std::string& label,
+                                       const std::string& head = "",
+                                       bool compressed = false);
+
+  /// \brief Completes key sink, stage timing follows key records.
+  void finishKeySink(KeySink& sink);
 
   void initJSON();
   void flushJSON();
+  void flushJSON(const KeyVect& coins,
+                 const OptionsOutput& options = OptionsOutput(0xff));
+  void flushJSON(const PassWordSaltKeyMap& coins);
 
   void addJSON(const UserInterface& ui);
   void addJSON(const UserInterface::WalletDTS& wallet);
   void addJSON(const UserInterface::WalletHD& wallet);
+  void addJSON(const UserInterface::WatchXpub& watch);
   void addJSON(const UserInterface& ui, const UserInterface::Attach& attach,
-               const ByteVect& pwd);
+               const Password& pwd);
   void addJSON(const CoinKeyPair& coin);
-  void addJSON(const KeyVect& coins,
-               const OptionsOutput& options = OptionsOutput(0xff));
-
-  void addJSON(const PassWordSaltKeyMap& coins);
+  void addJSON(const KeyExportWriter& exporter);
+  void addJSON(const TestVector& vector, const TestResult& result);
   void addJSON(const std::string& name, uint64_t combination, uint64_t cnt,
                uint64_t ms);
+  void addJSON(const std::vector<StageSummary>& stages);
 
   /// reference into user I/O parameters
   UserInterface& ui_;
@@ -88,6 +141,18 @@ class CommandInterpreter {
 
   /// JSON object for building command result
   json out_;
+
+  /// workers for bulk commands, created on first use
+  std::unique_ptr<ThreadPool> pool_;
+
+  /// workers shared with other interpreters, not owned
+  ThreadPool* shared_pool_;
+
+  /// cancellation of batch or daemon job, not owned
+  const CancelToken* cancel_;
+
+  /// counters of last KeyPipeline run
+  PipelineStats pipeline_stats_;
 };
 
 #endif  // COMMANDINTERPRETER_H
@@ -0,0 +1,62 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdexcept>
+
+#include "DerivationCache.h"
+
+DerivationCache::DerivationCache(const ExtendedKey& root) {
+  nodes_.emplace(DerivationPath(), root);
+}
+
+ExtendedKey DerivationCache::node(const DerivationPath& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lookup(path);
+}
+
+ExtendedKey DerivationCache::lookup(const DerivationPath& path) {
+  auto it = nodes_.find(path);
+  if (it != nodes_.end()) return it->second;
+
+  // walk back to longest cached prefix, then derive and cache the rest
+  size_t len = path.size();
+  DerivationPath prefix(path);
+  while (len > 0) {
+    prefix.resize(--len);
+    it = nodes_.find(prefix);
+    if (it != nodes_.end()) break;
+  }
+  ExtendedKey key = it->second;
+  for (size_t i = len; i < path.size(); i++) {
+    key = HDWallet::derive(key, path[i]);
+    prefix.push_back(path[i]);
+    nodes_.emplace(prefix, key);
+  }
+  return key;
+}
+
+void DerivationCache::range(const DerivationPath& parent, uint32_t begin,
+                            uint32_t end, std::vector<ExtendedKey>& out) {
+  if (end < begin)
+    throw std::invalid_argument("DerivationCache::invalid child range");
+  ExtendedKey p = node(parent);
+  out.clear();
+  out.reserve(end - begin);
+  for (uint32_t i = begin; i < end; i++) out.push_back(HDWallet::derive(p, i));
+}
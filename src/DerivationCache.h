@@ -0,0 +1,63 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DERIVATIONCACHE_H
+#define DERIVATIONCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "HDWallet.h"
+
+///
+/// \brief Cache of BIP32 tree nodes keyed by derivation path.
+///
+/// Paths are relative to root key given at construction. Node lookup
+/// starts from the longest cached prefix of path, so keys sharing a parent
+/// (e.g. all addresses of a chain) derive the parent once and then only
+/// the leaf step. Leaf keys of range() are not cached, cache size is
+/// bounded by the number of distinct parents requested.
+///
+/// Methods can be called concurrently, leaf derivations run outside of
+/// the lock.
+///
+class DerivationCache {
+ public:
+  explicit DerivationCache(const ExtendedKey& root);
+
+  DerivationCache(const DerivationCache&) = delete;
+  DerivationCache& operator=(const DerivationCache&) = delete;
+
+  /// \brief Returns node at path, derives and caches missing nodes.
+  ExtendedKey node(const DerivationPath& path);
+
+  /// \brief Derives children [begin, end) of node at 'parent' into 'out'.
+  void range(const DerivationPath& parent, uint32_t begin, uint32_t end,
+             std::vector<ExtendedKey>& out);
+
+ private:
+  ExtendedKey lookup(const DerivationPath& path);
+
+  std::mutex mutex_;
+  std::map<DerivationPath, ExtendedKey> nodes_;
+};
+
+#endif  // DERIVATIONCACHE_H
@@ -0,0 +1,327 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <stdexcept>
+
+#include "hmac.h"
+#include "sha512.h"
+using namespace cppcrypto;
+
+#include "CoinEncoding.h"
+#include "HDWallet.h"
+#include "Sha256Engine.h"
+
+namespace {
+/// \brief Version bytes of extended keys, private and public.
+struct ExtendedVersion {
+  uint32_t private_;
+  uint32_t public_;
+};
+
+ExtendedVersion extendedVersion(CoinId id) {
+  switch (id) {
+    case CoinId::kBitCoin:
+      return {0x0488ADE4, 0x0488B21E};  // xprv, xpub
+    case CoinId::kBitCoinTest:
+      return {0x04358394, 0x043587CF};  // tprv, tpub
+    case CoinId::kLiteCoin:
+      return {0x019D9CFE, 0x019DA462};  // Ltpv, Ltub
+    case CoinId::kLiteCoinTest:
+      return {0x0436EF7D, 0x0436F6E1};  // ttpv, ttub
+  }
+  throw std::invalid_argument("HDWallet::unknown network");
+}
+
+uint32_t loadBE(const uint8_t* p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 |
+         p[3];
+}
+
+void storeBE(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+/// \brief HMAC-SHA512 of two concatenated parts.
+void hmacSha512(const uint8_t* key, size_t key_len, const uint8_t* a,
+                size_t a_len, const uint8_t* b, size_t b_len, uint8_t out[64]) {
+  hmac h(sha512(), key, key_len);
+  h.init();
+  h.update(a, a_len);
+  if (b_len > 0) h.update(b, b_len);
+  h.final(out);
+}
+
+void publicKey(ExtendedKey& key) {
+  key.pub_ = Secp256k1::toAffine(Secp256k1::multiplyG(key.secret_));
+}
+}
+
+ExtendedKey HDWallet::master(const uint8_t* seed, size_t len) {
+  if (len < 16 || len > 64)
+    throw std::invalid_argument("HDWallet::seed length out of range [16,64]");
+  static const uint8_t KEY[] = {'B', 'i', 't', 'c', 'o', 'i',
+                                'n', ' ', 's', 'e', 'e', 'd'};
+  uint8_t I[64];
+  hmacSha512(KEY, sizeof(KEY), seed, len, nullptr, 0, I);
+  if (!Secp256k1::isValidSecret(I))
+    throw std::domain_error("HDWallet::invalid master key, use other seed");
+
+  ExtendedKey m;
+  m.depth_ = 0;
+  m.parent_fp_ = 0;
+  m.child_ = 0;
+  std::copy(I + 32, I + 64, m.chain_code_);
+  m.has_secret_ = true;
+  std::copy(I, I + 32, m.secret_);
+  publicKey(m);
+  secureWipe(I, sizeof(I));
+  return m;
+}
+
+ExtendedKey HDWallet::derive(const ExtendedKey& parent, uint32_t i) {
+  bool hardened = (i & kHardened) != 0;
+  if (hardened && !parent.has_secret_)
+    throw std::invalid_argument(
+        "HDWallet::hardened child of public key is not defined");
+  if (parent.depth_ == 0xff)
+    throw std::out_of_range("HDWallet::derivation depth exceeds 255");
+
+  // data = 0x00 || secret || i for hardened child, pub || i otherwise
+  uint8_t data[37];
+  if (hardened) {
+    data[0] = 0;
+    std::copy(parent.secret_, parent.secret_ + 32, data + 1);
+  } else {
+    Secp256k1::serialize(parent.pub_, true, data);
+  }
+  storeBE(data + 33, i);
+  uint8_t I[64];
+  hmacSha512(parent.chain_code_, 32, data, sizeof(data), nullptr, 0, I);
+  secureWipe(data, sizeof(data));
+
+  // probability of invalid child is below 2^-127, BIP32 leaves it to
+  // caller to proceed with next index
+  if (!Secp256k1::isBelowOrder(I))
+    throw std::domain_error("HDWallet::invalid child key, use next index");
+
+  ExtendedKey child;
+  child.depth_ = static_cast<uint8_t>(parent.depth_ + 1);
+  child.parent_fp_ = fingerprint(parent);
+  child.child_ = i;
+  std::copy(I + 32, I + 64, child.chain_code_);
+  child.has_secret_ = parent.has_secret_;
+  if (parent.has_secret_) {
+    // k = IL + k_par (mod n)
+    if (!Secp256k1::scalarAdd(I, parent.secret_, child.secret_))
+      throw std::domain_error("HDWallet::invalid child key, use next index");
+    publicKey(child);
+  } else {
+    // K = IL * G + K_par
+    secureWipe(child.secret_, sizeof(child.secret_));
+    child.pub_ = Secp256k1::toAffine(
+        Secp256k1::add(Secp256k1::multiplyG(I), parent.pub_));
+    if (child.pub_.infinity_)
+      throw std::domain_error("HDWallet::invalid child key, use next index");
+  }
+  secureWipe(I, sizeof(I));
+  return child;
+}
+
+void HDWallet::derivePublicKeys(const ExtendedKey& parent, uint32_t begin,
+                                size_t cnt, Secp256k1::Point* out) {
+  if (cnt > static_cast<size_t>(kHardened) ||
+      begin > kHardened - static_cast<uint32_t>(cnt))
+    throw std::invalid_argument(
+        "HDWallet::hardened child of public key is not defined");
+
+  // K_i = IL_i * G + K_par, all sums converted to affine at once
+  uint8_t data[37];
+  Secp256k1::serialize(parent.pub_, true, data);
+  hmac h(sha512(), parent.chain_code_, 32);
+  std::vector<Secp256k1::PointJ> sums(cnt);
+  uint8_t I[64];
+  for (size_t j = 0; j < cnt; j++) {
+    storeBE(data + 33, begin + static_cast<uint32_t>(j));
+    h.init();
+    h.update(data, sizeof(data));
+    h.final(I);
+    if (!Secp256k1::isBelowOrder(I))
+      throw std::domain_error("HDWallet::invalid child key, use next index");
+    sums[j] = Secp256k1::add(Secp256k1::multiplyG(I), parent.pub_);
+  }
+  Secp256k1::toAffine(sums.data(), out, cnt);
+  for (size_t j = 0; j < cnt; j++)
+    if (out[j].infinity_)
+      throw std::domain_error("HDWallet::invalid child key, use next index");
+}
+
+ExtendedKey HDWallet::derive(const ExtendedKey& key,
+                             const DerivationPath& path) {
+  ExtendedKey k = key;
+  for (auto i : path) k = derive(k, i);
+  return k;
+}
+
+ExtendedKey HDWallet::neuter(const ExtendedKey& key) {
+  ExtendedKey k = key;
+  k.has_secret_ = false;
+  secureWipe(k.secret_, sizeof(k.secret_));
+  return k;
+}
+
+DerivationPath HDWallet::parsePath(const std::string& path) {
+  static const std::string ERROR = "HDWallet::invalid derivation path ";
+  DerivationPath out;
+  if (path.empty() || path[0] != 'm')
+    throw std::invalid_argument(ERROR + path);
+  size_t pos = 1;
+  while (pos < path.size()) {
+    if (path[pos] != '/' || pos + 1 >= path.size())
+      throw std::invalid_argument(ERROR + path);
+    pos++;
+    uint64_t v = 0;
+    size_t digits = 0;
+    while (pos < path.size() && path[pos] >= '0' && path[pos] <= '9') {
+      v = v * 10 + (path[pos++] - '0');
+      if (v >= kHardened) throw std::invalid_argument(ERROR + path);
+      digits++;
+    }
+    if (digits == 0) throw std::invalid_argument(ERROR + path);
+    if (pos < path.size() &&
+        (path[pos] == '\'' || path[pos] == 'h' || path[pos] == 'H')) {
+      v |= kHardened;
+      pos++;
+    }
+    out.push_back(static_cast<uint32_t>(v));
+  }
+  return out;
+}
+
+std::string HDWallet::formatPath(const DerivationPath& path) {
+  std::string s("m");
+  for (auto i : path) {
+    s += '/';
+    s += std::to_string(i & ~kHardened);
+    if (i & kHardened) s += '\'';
+  }
+  return s;
+}
+
+DerivationPath HDWallet::accountPath(CoinId id, uint32_t account) {
+  return {44 | kHardened, coinType(id) | kHardened, account | kHardened};
+}
+
+uint32_t HDWallet::coinType(CoinId id) {
+  switch (id) {
+    case CoinId::kBitCoin:
+      return 0;
+    case CoinId::kLiteCoin:
+      return 2;
+    case CoinId::kBitCoinTest:
+    case CoinId::kLiteCoinTest:
+      return 1;
+  }
+  throw std::invalid_argument("HDWallet::unknown network");
+}
+
+uint32_t HDWallet::fingerprint(const ExtendedKey& key) {
+  uint8_t pub[33];
+  uint8_t hash[20];
+  Secp256k1::serialize(key.pub_, true, pub);
+  hash160(pub, sizeof(pub), hash);
+  return uint32_t(hash[0]) << 24 | uint32_t(hash[1]) << 16 |
+         uint32_t(hash[2]) << 8 | hash[3];
+}
+
+std::string HDWallet::serialize(const ExtendedKey& key, CoinId id) {
+  // version || depth || parent fingerprint || child || chain code || key
+  uint8_t data[78];
+  ExtendedVersion version = extendedVersion(id);
+  storeBE(data, key.has_secret_ ? version.private_ : version.public_);
+  data[4] = key.depth_;
+  storeBE(data + 5, key.parent_fp_);
+  storeBE(data + 9, key.child_);
+  std::copy(key.chain_code_, key.chain_code_ + 32, data + 13);
+  if (key.has_secret_) {
+    data[45] = 0;
+    std::copy(key.secret_, key.secret_ + 32, data + 46);
+  } else {
+    Secp256k1::serialize(key.pub_, true, data + 45);
+  }
+  std::string s = base58CheckEncode(data, sizeof(data));
+  secureWipe(data, sizeof(data));
+  return s;
+}
+
+ExtendedKey HDWallet::parse(const std::string& s, CoinId id) {
+  static const std::string ERROR = "HDWallet::invalid extended key";
+  ByteVect data;
+  if (!base58CheckDecode(reinterpret_cast<const uint8_t*>(s.data()), s.size(),
+                         data) ||
+      data.size() != 78)
+    throw std::invalid_argument(ERROR);
+  ExtendedVersion version = extendedVersion(id);
+  uint32_t v = loadBE(data.data());
+  if (v != version.private_ && v != version.public_)
+    throw std::invalid_argument(ERROR + ", version does not match network");
+
+  ExtendedKey key;
+  key.depth_ = data[4];
+  key.parent_fp_ = loadBE(&data[5]);
+  key.child_ = loadBE(&data[9]);
+  std::copy(&data[13], &data[45], key.chain_code_);
+  key.has_secret_ = (v == version.private_);
+  secureWipe(key.secret_, sizeof(key.secret_));
+  if (key.depth_ == 0 && (key.parent_fp_ != 0 || key.child_ != 0))
+    throw std::invalid_argument(ERROR);
+  if (key.has_secret_) {
+    if (data[45] != 0 || !Secp256k1::isValidSecret(&data[46]))
+      throw std::invalid_argument(ERROR);
+    std::copy(&data[46], &data[78], key.secret_);
+    publicKey(key);
+  } else if (!Secp256k1::parse(&data[45], 33, key.pub_)) {
+    throw std::invalid_argument(ERROR);
+  }
+  secureWipe(data.data(), data.size());
+  return key;
+}
+
+CoinKeyPair HDWallet::coinKeyPair(const ExtendedKey& key, CoinId id) {
+  uint8_t pub[33];
+  Secp256k1::serialize(key.pub_, true, pub);
+  return encodeKeyPair(id, pub, sizeof(pub),
+                       key.has_secret_ ? key.secret_ : nullptr);
+}
+
+bool dtsChildSecret(HmacSha256& mac, uint64_t index, uint8_t* secret) {
+  uint8_t msg[8];
+  for (int i = 0; i < 8; i++)
+    msg[i] = static_cast<uint8_t>(index >> (8 * (7 - i)));
+  uint8_t out[Sha256::kSize];
+  mac.init();
+  mac.update(msg, sizeof(msg));
+  mac.final(out);
+  Secp256k1::scalarReduce(out, secret);
+  secureWipe(out, sizeof(out));
+  return Secp256k1::isValidSecret(secret);
+}
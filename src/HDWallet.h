@@ -0,0 +1,118 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HDWALLET_H
+#define HDWALLET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CoinKeyPair.h"
+#include "Secp256k1.h"
+#include "SecureMemory.h"
+
+class HmacSha256;
+
+/// \brief Node of BIP32 key tree, secret and chain code are wiped when
+/// destroyed.
+struct ExtendedKey {
+  ~ExtendedKey() {
+    secureWipe(secret_, sizeof(secret_));
+    secureWipe(chain_code_, sizeof(chain_code_));
+  }
+
+  uint8_t depth_;         /// 0 for master key
+  uint32_t parent_fp_;    /// fingerprint of parent, 0 for master key
+  uint32_t child_;        /// child number, hardened if bit 31 set
+  uint8_t chain_code_[32];
+  bool has_secret_;       /// false for public (neutered) key
+  uint8_t secret_[32];
+  Secp256k1::Point pub_;
+};
+
+using DerivationPath = std::vector<uint32_t>;
+
+///
+/// \brief Hierarchical deterministic wallet as specified in BIP32.
+///
+/// Master key is derived from seed by HMAC-SHA512 with key "Bitcoin seed",
+/// children by private (CKDpriv) or public (CKDpub) derivation. Elliptic
+/// curve operations are done in-process, deriving a child costs one
+/// HMAC-SHA512 and one generator multiplication.
+///
+class HDWallet {
+ public:
+  static const uint32_t kHardened{0x80000000};
+
+  /// \brief Creates master key from seed of 16 to 64 bytes.
+  static ExtendedKey master(const uint8_t* seed, size_t len);
+
+  /// \brief Derives child 'i' of parent, private parent gives private
+  /// child. Hardened child requires private parent.
+  static ExtendedKey derive(const ExtendedKey& parent, uint32_t i);
+
+  /// \brief Derives public keys of non-hardened children [begin,
+  /// begin + cnt) of parent. Generator multiplications are batched and
+  /// share one field inversion.
+  static void derivePublicKeys(const ExtendedKey& parent, uint32_t begin,
+                               size_t cnt, Secp256k1::Point* out);
+
+  /// \brief Derives descendant along path relative to 'key'.
+  static ExtendedKey derive(const ExtendedKey& key, const DerivationPath& path);
+
+  /// \brief Returns public key of extended key.
+  static ExtendedKey neuter(const ExtendedKey& key);
+
+  /// \brief Parses path like "m/44'/0'/0'", hardened index is marked by
+  /// apostrophe, 'h' or 'H'.
+  static DerivationPath parsePath(const std::string& path);
+
+  /// \brief Formats path starting with "m".
+  static std::string formatPath(const DerivationPath& path);
+
+  /// \brief BIP44 path of account "m/44'/coin'/account'".
+  static DerivationPath accountPath(CoinId id, uint32_t account = 0);
+
+  /// \brief SLIP44 coin type of network.
+  static uint32_t coinType(CoinId id);
+
+  /// \brief Key identifier prefix, first 4 bytes of hash160 of public key.
+  static uint32_t fingerprint(const ExtendedKey& key);
+
+  /// \brief Base58check serialization, xprv for private key and xpub for
+  /// public key (or network specific equivalent).
+  static std::string serialize(const ExtendedKey& key, CoinId id);
+
+  /// \brief Parses base58check serialized extended key of network.
+  static ExtendedKey parse(const std::string& s, CoinId id);
+
+  /// \brief Coin key pair of extended key using compressed public key,
+  /// private key is included only if key has secret.
+  static CoinKeyPair coinKeyPair(const ExtendedKey& key, CoinId id);
+};
+
+/// \brief Child secret of simple deterministic wallet version 2,
+/// HMAC-SHA256(root, index) mod n with index as 8-byte big-endian integer.
+/// 'mac' is keyed by root key, it may be reused for many children. Returns
+/// false for invalid secret (zero), such child is skipped.
+bool dtsChildSecret(HmacSha256& mac, uint64_t index, uint8_t* secret);
+
+#endif  // HDWALLET_H
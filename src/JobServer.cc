@@ -0,0 +1,284 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "JobServer.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+/// longest accepted job line, connection is closed on longer lines
+const size_t MAX_LINE{1 << 20};
+
+/// interval of checking stop requests while waiting for connections
+const int POLL_INTERVAL_MS{200};
+
+/// longest time writing one result line may take, a client that does not
+/// read its results is disconnected so that it cannot block a worker
+const int SEND_TIMEOUT_MS{10000};
+
+volatile sig_atomic_t signalled{0};
+
+void onSignal(int) { signalled = 1; }
+
+sockaddr_un socketAddress(const std::string& path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    throw std::invalid_argument("JobServer::invalid socket path " + path);
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+/// \brief True when a server is accepting connections at path.
+bool isListening(const sockaddr_un& addr) {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  bool ok = (::connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                       sizeof(addr)) == 0);
+  ::close(fd);
+  return ok;
+}
+}
+
+struct JobServer::Connection {
+  explicit Connection(int fd) : fd_(fd), open_(true), pending_(0) {
+    timeval tv{SEND_TIMEOUT_MS / 1000, (SEND_TIMEOUT_MS % 1000) * 1000};
+    ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  }
+  ~Connection() { ::close(fd_); }
+
+  /// \brief Writes result line, lines of concurrent jobs do not interleave.
+  /// Connection is dropped when client is gone or line is not taken within
+  /// SEND_TIMEOUT_MS.
+  void write(const std::string& line) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string buf = line + '\n';
+    size_t done = 0;
+    auto deadline = Clock::now() + std::chrono::milliseconds(SEND_TIMEOUT_MS);
+    while (open_ && done < buf.size()) {
+      ssize_t n = ::send(fd_, buf.data() + done, buf.size() - done,
+                         MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR && Clock::now() < deadline) continue;
+      if (n <= 0 || Clock::now() >= deadline) {
+        // client gone or not reading, result is dropped, pending jobs
+        // cancelled and reader woken up
+        open_ = false;
+        cancel_.cancel();
+        ::shutdown(fd_, SHUT_RDWR);
+      }
+      if (n > 0) done += static_cast<size_t>(n);
+    }
+  }
+
+  int fd_;
+  bool open_;
+  std::mutex mutex_;
+  std::atomic<size_t> pending_;  /// jobs queued or running
+  CancelToken cancel_;           /// fires when client is gone
+};
+
+JobServer::JobServer(const std::string& path, ThreadPool& pool,
+                     size_t max_queue, Handler handler)
+    : path_(path),
+      pool_(pool),
+      max_queue_(max_queue == 0 ? 1 : max_queue),
+      handler_(handler),
+      fd_(-1),
+      stop_(false),
+      served_(0),
+      rejected_(0),
+      queued_(0),
+      readers_(0) {}
+
+JobServer::~JobServer() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    ::unlink(path_.c_str());
+  }
+}
+
+void JobServer::listen() {
+  sockaddr_un addr = socketAddress(path_);
+
+  // stale socket of crashed server is replaced, live one is not
+  struct stat st;
+  if (::lstat(path_.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode) || isListening(addr))
+      throw std::runtime_error("JobServer::socket path in use " + path_);
+    ::unlink(path_.c_str());
+  }
+
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) throw std::runtime_error("JobServer::socket failed");
+
+  // results contain private keys, only owner may connect
+  mode_t mask = ::umask(0077);
+  int rc = ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+  ::umask(mask);
+  if (rc != 0 || ::listen(fd_, SOMAXCONN) != 0) {
+    ::close(fd_);
+    fd_ = -1;
+    throw std::runtime_error("JobServer::cannot listen on " + path_);
+  }
+}
+
+void JobServer::run() {
+  listen();
+
+  struct sigaction sa, old_int, old_term;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal;
+  ::sigaction(SIGINT, &sa, &old_int);
+  ::sigaction(SIGTERM, &sa, &old_term);
+  signalled = 0;
+
+  while (!stop_ && !signalled) {
+    pollfd pfd{fd_, POLLIN, 0};
+    int n = ::poll(&pfd, 1, POLL_INTERVAL_MS);
+    if (n <= 0 || !(pfd.revents & POLLIN)) continue;
+    int fd = ::accept(fd_, nullptr, nullptr);
+    if (fd < 0) continue;
+
+    auto conn = std::make_shared<Connection>(fd);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      connections_.remove_if(
+          [](const std::weak_ptr<Connection>& c) { return c.expired(); });
+      connections_.push_back(conn);
+      readers_++;
+    }
+    std::thread(&JobServer::read, this, conn).detach();
+  }
+
+  shutdown();
+  ::sigaction(SIGINT, &old_int, nullptr);
+  ::sigaction(SIGTERM, &old_term, nullptr);
+}
+
+void JobServer::read(std::shared_ptr<Connection> conn) {
+  std::string buf;
+  uint64_t seq{0};
+  char chunk[4096];
+  for (;;) {
+    ssize_t n = ::recv(conn->fd_, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    buf.append(chunk, static_cast<size_t>(n));
+    size_t begin = 0;
+    for (size_t end; (end = buf.find('\n', begin)) != std::string::npos;
+         begin = end + 1) {
+      std::string line = buf.substr(begin, end - begin);
+      seq++;
+      if (line.find_first_not_of(" \t\r") != std::string::npos)
+        dispatch(conn, line, seq);
+    }
+    buf.erase(0, begin);
+    if (buf.size() > MAX_LINE) break;
+  }
+
+  // client may half-close after its last job, only hangup abandons jobs
+  while (conn->pending_ > 0) {
+    pollfd pfd{conn->fd_, 0, 0};
+    if (::poll(&pfd, 1, POLL_INTERVAL_MS) > 0 &&
+        (pfd.revents & (POLLHUP | POLLERR))) {
+      conn->cancel_.cancel();
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  readers_--;
+  idle_.notify_all();
+}
+
+void JobServer::dispatch(const std::shared_ptr<Connection>& conn,
+                         const std::string& line, uint64_t seq) {
+  Clock::time_point received = Clock::now();
+  bool busy{false};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    busy = (queued_ >= max_queue_);
+    if (busy) {
+      rejected_++;
+    } else {
+      queued_++;
+      conn->pending_++;
+      jobs_.push_back(Job{conn, line, seq, received});
+    }
+  }
+  if (busy) {
+    // reply is written without server lock, slow client stalls only itself
+    json record;
+    record["id"] = seq;
+    try {
+      json job = json::parse(line);
+      if (job.is_object() && job.count("id") > 0) record["id"] = job["id"];
+    } catch (std::exception&) {
+    }
+    record["error"] = "server busy";
+    conn->write(record.dump());
+    return;
+  }
+  pool_.submit([this] { runNext(); });
+}
+
+void JobServer::runNext() {
+  Job job;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job = std::move(jobs_.front());
+    jobs_.pop_front();
+  }
+  std::string result =
+      handler_(job.line_, job.seq_, job.received_, job.conn_->cancel_);
+  job.conn_->write(result);
+  job.conn_->pending_--;
+  served_++;
+  job.conn_.reset();
+  std::lock_guard<std::mutex> lock(mutex_);
+  queued_--;
+  idle_.notify_all();
+}
+
+void JobServer::shutdown() {
+  // new jobs are not read, queued and running jobs are completed
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto& c : connections_)
+    if (auto conn = c.lock()) ::shutdown(conn->fd_, SHUT_RD);
+  idle_.wait(lock, [this] { return readers_ == 0 && queued_ == 0; });
+  connections_.clear();
+  ::close(fd_);
+  ::unlink(path_.c_str());
+  fd_ = -1;
+}
@@ -0,0 +1,113 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "CancelToken.h"
+#include "ThreadPool.h"
+
+///
+/// \brief Serves JSONL derivation jobs over a Unix domain socket.
+///
+/// Clients send one JSON job per line and receive one result line per job
+/// on the same connection, in completion order. Jobs of all connections
+/// share one worker pool. At most 'max_queue' jobs are queued or running,
+/// further jobs are rejected at once with a busy error. Jobs of a client
+/// that hangs up or does not read its results are cancelled. Server runs
+/// until SIGINT or SIGTERM is received or stop() is called.
+///
+class JobServer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// \brief Runs job line, 'seq' is line number within connection and
+  /// 'received' the time line was read. Returns result line. Token 'cancel'
+  /// fires when client of the job is gone.
+  using Handler = std::function<std::string(
+      const std::string& line, uint64_t seq, Clock::time_point received,
+      const CancelToken& cancel)>;
+
+  JobServer(const std::string& path, ThreadPool& pool, size_t max_queue,
+            Handler handler);
+  virtual ~JobServer();
+
+  JobServer(const JobServer&) = delete;
+  JobServer& operator=(const JobServer&) = delete;
+
+  /// \brief Accepts connections until stopped, then waits for running jobs.
+  void run();
+
+  /// \brief Requests server to stop, safe to call from any thread.
+  void stop() { stop_ = true; }
+
+  /// \brief Number of jobs completed.
+  uint64_t served() const { return served_; }
+
+  /// \brief Number of jobs rejected because queue was full.
+  uint64_t rejected() const { return rejected_; }
+
+ private:
+  struct Connection;
+
+  struct Job {
+    std::shared_ptr<Connection> conn_;
+    std::string line_;
+    uint64_t seq_;
+    Clock::time_point received_;
+  };
+
+  void listen();
+  void read(std::shared_ptr<Connection> conn);
+  void dispatch(const std::shared_ptr<Connection>& conn,
+                const std::string& line, uint64_t seq);
+  void runNext();
+  void shutdown();
+
+  std::string path_;
+  ThreadPool& pool_;
+  size_t max_queue_;
+  Handler handler_;
+  int fd_;
+
+  std::atomic<bool> stop_;
+  std::atomic<uint64_t> served_;
+  std::atomic<uint64_t> rejected_;
+
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  std::deque<Job> jobs_;  /// jobs waiting for worker, oldest first
+  size_t queued_;   /// jobs queued or running
+  size_t readers_;  /// connection reader threads running
+  std::list<std::weak_ptr<Connection>> connections_;
+};
+
+#endif  // JOBSERVER_H
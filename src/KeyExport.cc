@@ -0,0 +1,231 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CoinEncoding.h"
+#include "KeyExport.h"
+#include "StageStats.h"
+
+namespace {
+const char MAGIC[4] = {'W', 'W', 'K', 'X'};
+const size_t TYPE_SIZE{32};
+
+template <typename T>
+void storeLE(uint8_t* p, T v) {
+  for (size_t i = 0; i < sizeof(T); i++) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+template <typename T>
+T loadLE(const uint8_t* p) {
+  T v{0};
+  for (size_t i = 0; i < sizeof(T); i++) v |= static_cast<T>(p[i]) << (8 * i);
+  return v;
+}
+
+std::string systemError(const std::string& what) {
+  return what + ": " + std::strerror(errno);
+}
+}
+
+KeyExportWriter::KeyExportWriter(const std::string& path, CoinId network,
+                                 bool compressed, bool has_secret,
+                                 KeyExportWallet wallet,
+                                 const std::string& type, uint64_t count,
+                                 uint64_t first_index)
+    : path_(path), next_(0), fd_(-1), map_(nullptr), size_(0) {
+  header_.version_ = KeyExportHeader::kVersion;
+  header_.network_ = network;
+  header_.flags_ = (compressed ? kExportCompressed : 0) |
+                   (has_secret ? kExportSecret : 0);
+  header_.wallet_ = wallet;
+  header_.count_ = count;
+  header_.first_index_ = first_index;
+  header_.created_ = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+  header_.type_ = type.substr(0, TYPE_SIZE);
+  header_.record_size_ = header_.recordSize();
+
+  size_ = KeyExportHeader::kSize + count * header_.record_size_;
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd_ < 0)
+    throw std::runtime_error(systemError("KeyExportWriter::open " + path));
+  if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+    close();
+    throw std::runtime_error(systemError("KeyExportWriter::ftruncate"));
+  }
+  void* p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED) {
+    close();
+    throw std::runtime_error(systemError("KeyExportWriter::mmap"));
+  }
+  map_ = static_cast<uint8_t*>(p);
+}
+
+KeyExportWriter::~KeyExportWriter() { close(); }
+
+void KeyExportWriter::close() {
+  if (map_ != nullptr) ::munmap(map_, size_);
+  if (fd_ >= 0) ::close(fd_);
+  map_ = nullptr;
+  fd_ = -1;
+}
+
+void KeyExportWriter::write(uint64_t index, const CoinKeyPair& coin, ByteView) {
+  write(next_++, index, coin);
+}
+
+void KeyExportWriter::write(uint64_t slot, uint64_t index,
+                            const CoinKeyPair& coin) {
+  StageTimer timer(Stage::kSerialization);
+  if (map_ == nullptr || slot >= header_.count_)
+    throw std::out_of_range("KeyExportWriter::record slot out of range");
+
+  uint8_t* rec = map_ + KeyExportHeader::kSize + slot * header_.record_size_;
+  storeLE<uint64_t>(rec, index);
+  if (!addressToHash160(coin.address(), rec + 8))
+    throw std::domain_error("KeyExportWriter::invalid address");
+
+  ByteVect pub;
+  const ByteVect& hex = coin.publicKey();
+  if (!hexDecode(hex.data(), hex.size(), pub) ||
+      pub.size() != header_.publicKeySize())
+    throw std::domain_error("KeyExportWriter::invalid public key");
+  std::copy(pub.begin(), pub.end(), rec + 28);
+
+  if (header_.flags_ & kExportSecret) {
+    SecretKey secret;
+    if (!wifToSecret(coin.privateKey(), secret))
+      throw std::domain_error("KeyExportWriter::invalid private key");
+    std::copy(secret.begin(), secret.end(), rec + 28 + pub.size());
+  }
+}
+
+void KeyExportWriter::finish() {
+  if (map_ == nullptr) return;
+  // records stored in sequence may end early, e.g. skipped invalid keys
+  if (next_ != 0 && next_ < header_.count_) header_.count_ = next_;
+  uint8_t* h = map_;
+  std::fill(h, h + KeyExportHeader::kSize, 0);
+  std::copy(std::begin(MAGIC), std::end(MAGIC), h);
+  storeLE<uint16_t>(h + 4, header_.version_);
+  storeLE<uint16_t>(h + 6, KeyExportHeader::kSize);
+  storeLE<uint32_t>(h + 8, header_.record_size_);
+  h[12] = static_cast<uint8_t>(header_.network_);
+  h[13] = header_.flags_;
+  h[14] = static_cast<uint8_t>(header_.wallet_);
+  storeLE<uint64_t>(h + 16, header_.count_);
+  storeLE<uint64_t>(h + 24, header_.first_index_);
+  storeLE<uint64_t>(h + 32, header_.created_);
+  std::copy(header_.type_.begin(), header_.type_.end(), h + 40);
+
+  int err = ::msync(map_, size_, MS_SYNC);
+  close();
+  if (err != 0) throw std::runtime_error(systemError("KeyExportWriter::msync"));
+}
+
+KeyExportReader::KeyExportReader(const std::string& path)
+    : fd_(-1), map_(nullptr), size_(0), offset_(0) {
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0)
+    throw std::runtime_error(systemError("KeyExportReader::open " + path));
+  struct stat st;
+  if (::fstat(fd_, &st) != 0 || st.st_size < KeyExportHeader::kSize) {
+    ::close(fd_);
+    throw std::domain_error("KeyExportReader::file too short");
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED) {
+    ::close(fd_);
+    throw std::runtime_error(systemError("KeyExportReader::mmap"));
+  }
+  map_ = static_cast<const uint8_t*>(p);
+
+  // validate header before any record is accessed
+  const uint8_t* h = map_;
+  std::string error;
+  if (!std::equal(std::begin(MAGIC), std::end(MAGIC), h))
+    error = "KeyExportReader::not a key export file";
+  header_.version_ = loadLE<uint16_t>(h + 4);
+  offset_ = loadLE<uint16_t>(h + 6);
+  header_.record_size_ = loadLE<uint32_t>(h + 8);
+  header_.network_ = CoinId(h[12]);
+  header_.flags_ = h[13];
+  header_.wallet_ = KeyExportWallet(h[14]);
+  header_.count_ = loadLE<uint64_t>(h + 16);
+  header_.first_index_ = loadLE<uint64_t>(h + 24);
+  header_.created_ = loadLE<uint64_t>(h + 32);
+  const char* type = reinterpret_cast<const char*>(h + 40);
+  header_.type_.assign(type, strnlen(type, TYPE_SIZE));
+
+  if (error.empty() && header_.version_ != KeyExportHeader::kVersion)
+    error = "KeyExportReader::unsupported format version";
+  if (error.empty() && (offset_ < KeyExportHeader::kSize || offset_ > size_ ||
+                        header_.record_size_ != header_.recordSize()))
+    error = "KeyExportReader::invalid header";
+  if (error.empty() &&
+      (size_ - offset_) / header_.record_size_ < header_.count_)
+    error = "KeyExportReader::file truncated";
+  if (!error.empty()) {
+    ::munmap(const_cast<uint8_t*>(map_), size_);
+    ::close(fd_);
+    throw std::domain_error(error);
+  }
+}
+
+KeyExportReader::~KeyExportReader() {
+  ::munmap(const_cast<uint8_t*>(map_), size_);
+  ::close(fd_);
+}
+
+KeyExportRecord KeyExportReader::record(uint64_t i) const {
+  if (i >= header_.count_)
+    throw std::out_of_range("KeyExportReader::record index out of range");
+  const uint8_t* rec = map_ + offset_ + i * header_.record_size_;
+  KeyExportRecord r;
+  r.index_ = loadLE<uint64_t>(rec);
+  r.hash160_ = rec + 8;
+  r.pub_ = rec + 28;
+  r.secret_ = (header_.flags_ & kExportSecret
+                   ? rec + 28 + header_.publicKeySize()
+                   : nullptr);
+  return r;
+}
+
+std::string KeyExportReader::address(uint64_t i) const {
+  return hash160ToAddress(header_.network_, record(i).hash160_);
+}
+
+std::string KeyExportReader::wif(uint64_t i) const {
+  KeyExportRecord r = record(i);
+  if (r.secret_ == nullptr) return std::string();
+  return secretToWif(header_.network_, r.secret_,
+                     header_.flags_ & kExportCompressed);
+}
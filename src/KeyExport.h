@@ -0,0 +1,181 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KEYEXPORT_H
+#define KEYEXPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "CoinKeyPair.h"
+#include "KeyWriter.h"
+
+/*
+ * Binary key export file, version 1. All integers are little-endian.
+ * ***************************************************************************
+ * header, 128 bytes:
+ *   0  char[4]  magic "WWKX"
+ *   4  uint16   format version
+ *   6  uint16   header size, offset of first record
+ *   8  uint32   record size
+ *  12  uint8    network, CoinId
+ *  13  uint8    flags, KeyExportFlags
+ *  14  uint8    wallet, KeyExportWallet
+ *  15  uint8    reserved
+ *  16  uint64   record count
+ *  24  uint64   index of first record (DTS magic number)
+ *  32  uint64   creation time, seconds since epoch
+ *  40  char[32] wallet type as in JSON output, zero padded
+ *  72  reserved, zero
+ *
+ * record:
+ *   0  uint64   key index
+ *   8  uint8[20] hash160 of public key
+ *  28  uint8[33|65] public key, compressed or uncompressed
+ *  +   uint8[32] secret, omitted for watch-only export
+ */
+
+/// header flags
+enum KeyExportFlags : uint8_t {
+  kExportCompressed = 0x01,  /// 33-byte compressed public keys
+  kExportSecret = 0x02       /// records contain secret key
+};
+
+/// wallet type of exported keys
+enum class KeyExportWallet : uint8_t {
+  kKeys = 0,
+  kRandom,
+  kDeterministicSimple,
+  kDeterministicHD
+};
+
+/// \brief Header of binary key export file.
+struct KeyExportHeader {
+  static const uint16_t kVersion{1};
+  static const uint16_t kSize{128};
+
+  uint16_t version_;
+  uint32_t record_size_;
+  CoinId network_;
+  uint8_t flags_;
+  KeyExportWallet wallet_;
+  uint64_t count_;
+  uint64_t first_index_;
+  uint64_t created_;
+  std::string type_;
+
+  /// \brief Size of public key field.
+  size_t publicKeySize() const {
+    return (flags_ & kExportCompressed ? 33 : 65);
+  }
+
+  /// \brief Record size implied by flags.
+  uint32_t recordSize() const {
+    return static_cast<uint32_t>(8 + 20 + publicKeySize() +
+                                 (flags_ & kExportSecret ? 32 : 0));
+  }
+};
+
+/// \brief Read-only view into record of binary export file.
+struct KeyExportRecord {
+  uint64_t index_;
+  const uint8_t* hash160_;  /// 20 bytes
+  const uint8_t* pub_;      /// publicKeySize() bytes
+  const uint8_t* secret_;   /// 32 bytes or nullptr for watch-only export
+};
+
+///
+/// \brief Writes key records into memory-mapped binary export file.
+///
+/// File is sized for 'count' records when opened and records are stored
+/// directly into the mapping. Header is written by finish(), an export
+/// that was not finished is rejected by reader.
+///
+class KeyExportWriter : public KeySink {
+ public:
+  KeyExportWriter(const std::string& path, CoinId network, bool compressed,
+                  bool has_secret, KeyExportWallet wallet,
+                  const std::string& type, uint64_t count,
+                  uint64_t first_index = 0);
+  virtual ~KeyExportWriter();
+
+  KeyExportWriter(const KeyExportWriter&) = delete;
+  KeyExportWriter& operator=(const KeyExportWriter&) = delete;
+
+  /// \brief Stores record into next slot, label is not exported.
+  void write(uint64_t index, const CoinKeyPair& coin,
+             ByteView label = ByteView()) override;
+
+  /// \brief Stores record into given slot, slots can be written in any
+  /// order and concurrently from several threads.
+  void write(uint64_t slot, uint64_t index, const CoinKeyPair& coin);
+
+  /// \brief Writes header, syncs and unmaps file. When records were stored
+  /// in sequence and fewer than 'count', header has the stored count.
+  void finish() override;
+
+  const KeyExportHeader& header() const { return header_; }
+  const std::string& path() const { return path_; }
+
+ private:
+  void close();
+
+  std::string path_;
+  KeyExportHeader header_;
+  uint64_t next_;
+  int fd_;
+  uint8_t* map_;
+  size_t size_;
+};
+
+///
+/// \brief Random access reader of memory-mapped binary export file.
+///
+class KeyExportReader {
+ public:
+  explicit KeyExportReader(const std::string& path);
+  virtual ~KeyExportReader();
+
+  KeyExportReader(const KeyExportReader&) = delete;
+  KeyExportReader& operator=(const KeyExportReader&) = delete;
+
+  const KeyExportHeader& header() const { return header_; }
+
+  /// \brief Number of records.
+  uint64_t size() const { return header_.count_; }
+
+  /// \brief Record at position i.
+  KeyExportRecord record(uint64_t i) const;
+
+  /// \brief Base58check address of record at position i.
+  std::string address(uint64_t i) const;
+
+  /// \brief Private key WIF of record at position i, empty if watch-only.
+  std::string wif(uint64_t i) const;
+
+ private:
+  KeyExportHeader header_;
+  int fd_;
+  const uint8_t* map_;
+  size_t size_;
+  size_t offset_;
+};
+
+#endif  // KEYEXPORT_H
@@ -0,0 +1,317 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include "CoinEncoding.h"
+#include "KeyPipeline.h"
+#include "LockFreeQueue.h"
+#include "Secp256k1.h"
+#include "SecureMemory.h"
+
+namespace {
+/// secrets encoded together, sharing one field inversion
+const size_t ENCODE_BATCH{64};
+
+/// key latencies kept for percentiles
+const size_t LATENCY_SAMPLES{10000};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+/// \brief Waits a moment for a queue, first yielding then sleeping.
+class Backoff {
+ public:
+  Backoff() : spins_(0) {}
+  void wait() {
+    if (++spins_ < 32)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(
+          std::chrono::microseconds(spins_ < 256 ? 50 : 500));
+  }
+  void reset() { spins_ = 0; }
+
+ private:
+  unsigned int spins_;
+};
+
+/// \brief Depth samples of a queue, updated by its producers.
+struct DepthGauge {
+  DepthGauge() : sum_(0), samples_(0), max_(0) {}
+  void sample(size_t depth) {
+    sum_ += depth;
+    samples_++;
+    size_t m = max_.load(std::memory_order_relaxed);
+    while (depth > m && !max_.compare_exchange_weak(m, depth)) {
+    }
+  }
+  double avg() const {
+    return (samples_ ? static_cast<double>(sum_) / samples_ : 0.0);
+  }
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> samples_;
+  std::atomic<size_t> max_;
+};
+
+/// \brief Uniform sample of a stream of latencies (reservoir sampling).
+class LatencySample {
+ public:
+  LatencySample() : seen_(0) { samples_.reserve(LATENCY_SAMPLES); }
+  void add(double ms) {
+    seen_++;
+    if (samples_.size() < LATENCY_SAMPLES) {
+      samples_.push_back(ms);
+    } else {
+      uint64_t k = std::uniform_int_distribution<uint64_t>(0, seen_ - 1)(rng_);
+      if (k < LATENCY_SAMPLES) samples_[k] = ms;
+    }
+  }
+  double percentile(double p) {
+    if (samples_.empty()) return 0.0;
+    size_t k = static_cast<size_t>(p * (samples_.size() - 1) + 0.5);
+    std::nth_element(samples_.begin(), samples_.begin() + k, samples_.end());
+    return samples_[k];
+  }
+
+ private:
+  uint64_t seen_;
+  std::vector<double> samples_;
+  std::minstd_rand rng_;
+};
+
+struct Derived {
+  uint64_t index_;
+  Clock::time_point start_;
+  SecretKey secret_;
+  Password label_;
+};
+
+struct Encoded {
+  uint64_t index_{0};
+  Clock::time_point start_;
+  CoinKeyPair coin_{CoinId::kBitCoin};
+  Password label_;
+};
+}
+
+void PipelineStats::report(std::ostream& os) const {
+  os << "pipeline " << std::fixed << std::setprecision(1) << wall_ms_ / 1000
+     << " s:";
+  for (size_t i = 0; i < stages_.size(); i++) {
+    const PipelineStage& s = stages_[i];
+    double util = (wall_ms_ > 0 && s.workers_ > 0)
+                      ? 100.0 * s.busy_ms_ / (wall_ms_ * s.workers_)
+                      : 0.0;
+    os << (i ? " |" : "") << ' ' << s.name_ << ' ' << s.items_ << " items, "
+       << s.workers_ << (s.workers_ == 1 ? " worker " : " workers ") << util
+       << "% busy";
+    if (i > 0)
+      os << ", queue avg " << std::setprecision(2) << s.queue_avg_ << " max "
+         << s.queue_max_ << std::setprecision(1);
+  }
+  os << " | latency p50 " << latency_p50_ms_ << " ms p99 " << latency_p99_ms_
+     << " ms" << std::endl;
+}
+
+KeyPipeline::KeyPipeline(ThreadPool& pool, CoinId id, bool compressed,
+                         bool with_secret, size_t interleave)
+    : pool_(pool),
+      id_(id),
+      compressed_(compressed),
+      with_secret_(with_secret),
+      interleave_(std::max<size_t>(1, interleave)),
+      stats_{0, {}, 0, 0} {}
+
+void KeyPipeline::run(uint64_t count, const DeriveFn& derive,
+                      const WriteFn& write) {
+  Clock::time_point start = Clock::now();
+
+  // at most 'window' keys are between KDF and output, queues never fill
+  const size_t window = 2 * pool_.size() * interleave_ + ENCODE_BATCH;
+  MpmcQueue<Derived> derived(window);
+  SpscQueue<Encoded> encoded(window);
+  DepthGauge derived_depth, encoded_depth;
+
+  std::atomic<bool> failed(false);
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto fail = [&](std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!error) error = e;
+    failed = true;
+  };
+
+  std::atomic<uint64_t> kdf_ns(0);
+  std::atomic<size_t> kdf_running(0);
+  // tasks claim batches in index order when they start, pool may run them
+  // in any order but output would wait for the lowest index
+  std::atomic<uint64_t> claimed(0);
+  auto kdf = [&] {
+    // queued tasks of a failed run only release their frame reference
+    if (failed) {
+      kdf_running--;
+      return;
+    }
+    Clock::time_point t0 = Clock::now();
+    uint64_t first = claimed.fetch_add(interleave_);
+    size_t n = std::min<uint64_t>(interleave_, count - first);
+    try {
+      SecretKeys secrets(n);
+      std::vector<Password> labels(n);
+      derive(first, n, secrets.data(), labels.data());
+      Backoff backoff;
+      Derived item;
+      item.start_ = t0;
+      for (size_t j = 0; j < n; j++) {
+        item.index_ = first + j;
+        item.secret_ = secrets[j];
+        item.label_ = std::move(labels[j]);
+        secureWipe(secrets[j].data(), secrets[j].size());
+        while (!derived.push(item)) backoff.wait();
+        derived_depth.sample(derived.size());
+      }
+      secureWipe(item.secret_.data(), item.secret_.size());
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    kdf_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  Clock::now() - t0)
+                  .count();
+    kdf_running--;
+  };
+
+  // EC and encoding stage
+  double encode_ms{0};
+  std::thread encoder([&] {
+    std::vector<Derived> batch(ENCODE_BATCH);
+    std::vector<Secp256k1::PointJ> sums(ENCODE_BATCH);
+    std::vector<Secp256k1::Point> points(ENCODE_BATCH);
+    uint8_t pub[65];
+    uint64_t done{0};
+    Backoff backoff;
+    try {
+      while (done < count && !failed) {
+        size_t n = 0;
+        while (n < ENCODE_BATCH && derived.pop(batch[n])) n++;
+        if (n == 0) {
+          backoff.wait();
+          continue;
+        }
+        backoff.reset();
+        Clock::time_point t0 = Clock::now();
+        for (size_t j = 0; j < n; j++) {
+          if (!Secp256k1::isValidSecret(batch[j].secret_.data()))
+            throw std::domain_error("KeyPipeline::invalid secret key");
+          sums[j] = Secp256k1::multiplyG(batch[j].secret_.data());
+        }
+        Secp256k1::toAffine(sums.data(), points.data(), n);
+        for (size_t j = 0; j < n; j++) {
+          Encoded item;
+          item.index_ = batch[j].index_;
+          item.start_ = batch[j].start_;
+          size_t len = Secp256k1::serialize(points[j], compressed_, pub);
+          item.coin_ = encodeKeyPair(
+              id_, pub, len, with_secret_ ? batch[j].secret_.data() : nullptr);
+          item.label_ = std::move(batch[j].label_);
+          secureWipe(batch[j].secret_.data(), batch[j].secret_.size());
+          while (!encoded.push(item)) backoff.wait();
+          encoded_depth.sample(encoded.size());
+        }
+        encode_ms += elapsedMs(t0);
+        done += n;
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  });
+
+  // output stage in calling thread, keys are reordered into index order
+  std::vector<Encoded> ring(window);
+  std::vector<bool> ready(window, false);
+  uint64_t submitted{0};
+  uint64_t written{0};
+  double output_ms{0};
+  LatencySample latency;
+  Backoff backoff;
+  try {
+    while (written < count && !failed) {
+      while (submitted < count) {
+        size_t n = std::min<uint64_t>(interleave_, count - submitted);
+        if (submitted + n > written + window) break;
+        kdf_running++;
+        submitted += n;
+        pool_.submit([&kdf] { kdf(); }, this);
+      }
+      Encoded item;
+      bool got = false;
+      while (encoded.pop(item)) {
+        size_t slot = item.index_ % window;
+        ring[slot] = std::move(item);
+        ready[slot] = true;
+        got = true;
+      }
+      Clock::time_point t0 = Clock::now();
+      while (written < count && ready[written % window]) {
+        size_t slot = written % window;
+        write(written, ring[slot].coin_, ring[slot].label_);
+        latency.add(elapsedMs(ring[slot].start_));
+        ready[slot] = false;
+        written++;
+      }
+      output_ms += elapsedMs(t0);
+      if (got) {
+        backoff.reset();
+      } else if (!(pool_.isWorker() && pool_.runPending(this))) {
+        // a worker caller runs KDF tasks of this run, others wait for them
+        backoff.wait();
+      }
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+
+  // KDF tasks and encoder refer to this frame
+  encoder.join();
+  while (kdf_running > 0)
+    if (!(pool_.isWorker() && pool_.runPending(this))) backoff.wait();
+
+  stats_.wall_ms_ = elapsedMs(start);
+  stats_.stages_ = {
+      {"kdf", static_cast<unsigned int>(pool_.size()), submitted,
+       kdf_ns / 1e6, 0.0, 0},
+      {"encode", 1, written, encode_ms, derived_depth.avg(),
+       derived_depth.max_},
+      {"output", 1, written, output_ms, encoded_depth.avg(),
+       encoded_depth.max_}};
+  stats_.latency_p50_ms_ = latency.percentile(0.50);
+  stats_.latency_p99_ms_ = latency.percentile(0.99);
+  if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,97 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KEYPIPELINE_H
+#define KEYPIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "CoinKeyPair.h"
+#include "RandomSeedGenerator.h"
+#include "ThreadPool.h"
+
+/// \brief Counters of one pipeline stage.
+struct PipelineStage {
+  std::string name_;
+  unsigned int workers_;
+  uint64_t items_;
+  double busy_ms_;    /// summed over workers
+  double queue_avg_;  /// mean depth of input queue, sampled on each push
+  size_t queue_max_;  /// max depth of input queue
+};
+
+/// \brief Counters of a completed pipeline run.
+struct PipelineStats {
+  double wall_ms_;
+  std::vector<PipelineStage> stages_;
+  double latency_p50_ms_;  /// key latency from KDF start to output
+  double latency_p99_ms_;
+
+  /// \brief Writes one line summary of stage utilization and queue depths.
+  void report(std::ostream& os) const;
+};
+
+///
+/// \brief Staged key generation, KDF -> EC/encoding -> output.
+///
+/// KDF runs on pool workers, which push secrets into a bounded lock-free
+/// MPMC queue. One encoder thread takes secrets in batches, computes their
+/// public keys sharing one field inversion and encodes key pairs into an
+/// SPSC queue. Calling thread writes key pairs in index order. Memory
+/// bound KDF workers never wait for encoding or output, unless the output
+/// falls a whole window behind.
+///
+class KeyPipeline {
+ public:
+  /// \brief Derives secrets of indexes [first, first + n), labels are
+  /// written with the keys.
+  using DeriveFn = std::function<void(uint64_t first, size_t n,
+                                      SecretKey* secrets, Password* labels)>;
+
+  /// \brief Writes key pair of index i, called in index order.
+  using WriteFn = std::function<void(uint64_t i, const CoinKeyPair& coin,
+                                     const Password& label)>;
+
+  /// \brief Pipeline encoding keys of network 'id', private keys are
+  /// omitted when 'with_secret' is false. Each KDF task derives
+  /// 'interleave' keys.
+  KeyPipeline(ThreadPool& pool, CoinId id, bool compressed, bool with_secret,
+              size_t interleave = 1);
+
+  /// \brief Runs indexes [0, count), rethrows first error of any stage.
+  void run(uint64_t count, const DeriveFn& derive, const WriteFn& write);
+
+  const PipelineStats& stats() const { return stats_; }
+
+ private:
+  ThreadPool& pool_;
+  CoinId id_;
+  bool compressed_;
+  bool with_secret_;
+  size_t interleave_;
+  PipelineStats stats_;
+};
+
+#endif  // KEYPIPELINE_H
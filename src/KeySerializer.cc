@@ -0,0 +1,227 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "KeySerializer.h"
+
+namespace {
+/// \brief Two hex digits for each byte value.
+struct HexTable {
+  constexpr HexTable(const char* digits) : pairs_() {
+    for (int i = 0; i < 256; i++) {
+      pairs_[2 * i] = digits[i >> 4];
+      pairs_[2 * i + 1] = digits[i & 0x0f];
+    }
+  }
+  char pairs_[512];
+};
+
+constexpr HexTable HEX_LOWER("0123456789abcdef");
+constexpr HexTable HEX_UPPER("0123456789ABCDEF");
+
+/// \brief Appends public key hex in upper case, as in JSON output.
+void appendUpper(std::string& buf, const ByteVect& v) {
+  for (auto c : v)
+    buf += static_cast<char>(c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c);
+}
+
+void appendString(std::string& buf, ByteView v) {
+  buf.append(reinterpret_cast<const char*>(v.data()), v.size());
+}
+
+/// \brief Appends JSON member name and value separator.
+void appendName(std::string& buf, const char* name, bool pretty) {
+  buf += '"';
+  buf += name;
+  buf += (pretty ? "\": " : "\":");
+}
+}
+
+void appendHex(std::string& buf, const uint8_t* data, size_t len, bool upper) {
+  const char* table = (upper ? HEX_UPPER.pairs_ : HEX_LOWER.pairs_);
+  size_t pos = buf.size();
+  buf.resize(pos + 2 * len);
+  char* out = &buf[pos];
+  for (size_t i = 0; i < len; i++) {
+    out[2 * i] = table[2 * data[i]];
+    out[2 * i + 1] = table[2 * data[i] + 1];
+  }
+}
+
+void appendUInt(std::string& buf, uint64_t value) {
+  char tmp[20];
+  int n = 0;
+  do {
+    tmp[n++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) buf += tmp[--n];
+}
+
+void appendJsonString(std::string& buf, const uint8_t* data, size_t len) {
+  buf += '"';
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = data[i];
+    if (c == '"' || c == '\\') {
+      buf += '\\';
+      buf += static_cast<char>(c);
+    } else if (c < 0x20) {
+      static const char* ESCAPED = "btn\0fr";
+      if (c >= '\b' && c <= '\r' && c != 0x0b) {
+        buf += '\\';
+        buf += ESCAPED[c - '\b'];
+      } else {
+        buf += "\\u00";
+        appendHex(buf, &c, 1);
+      }
+    } else {
+      buf += static_cast<char>(c);
+    }
+  }
+  buf += '"';
+}
+
+void KeySerializer::csvHeader(std::string& buf) const {
+  buf += "index";
+  if (hasLabel()) {
+    buf += ',';
+    buf += label_;
+  }
+  if (options_.test(OptionsOutputEnum::kKeysAddress)) buf += ",address";
+  if (options_.test(OptionsOutputEnum::kKeysPublicKey)) buf += ",publicKeyHex";
+  if (options_.test(OptionsOutputEnum::kKeysPrivKey)) buf += ",privateKeyWif";
+  buf += '\n';
+}
+
+void KeySerializer::csv(std::string& buf, uint64_t index,
+                        const CoinKeyPair& coin, ByteView label) const {
+  // fields are base58, hex, alphanumeric or paths, no quoting needed
+  appendUInt(buf, index);
+  if (hasLabel()) {
+    buf += ',';
+    if (!label.empty()) appendString(buf, label);
+  }
+  if (options_.test(OptionsOutputEnum::kKeysAddress)) {
+    buf += ',';
+    appendString(buf, coin.address());
+  }
+  if (options_.test(OptionsOutputEnum::kKeysPublicKey)) {
+    buf += ',';
+    appendUpper(buf, coin.publicKey());
+  }
+  if (options_.test(OptionsOutputEnum::kKeysPrivKey)) {
+    buf += ',';
+    appendString(buf, coin.privateKey());
+  }
+  buf += '\n';
+}
+
+void KeySerializer::ndjson(std::string& buf, uint64_t index,
+                           const CoinKeyPair& coin, ByteView label) const {
+  // members in the same order as json object sorts them
+  buf += '{';
+  if (hasLabel() && !label.empty()) {
+    appendName(buf, member_.c_str(), false);
+    appendJsonString(buf, label.data(), label.size());
+    buf += ',';
+  }
+  appendName(buf, "index", false);
+  appendUInt(buf, index);
+  bool first{true};
+  auto member = [&](const char* name) {
+    buf += (first ? ",\"key\":{" : ",");
+    first = false;
+    appendName(buf, name, false);
+    buf += '"';
+  };
+  if (options_.test(OptionsOutputEnum::kKeysAddress)) {
+    member("address");
+    appendString(buf, coin.address());
+    buf += '"';
+  }
+  if (options_.test(OptionsOutputEnum::kKeysPrivKey)) {
+    member("privateKeyWif");
+    appendString(buf, coin.privateKey());
+    buf += '"';
+  }
+  if (options_.test(OptionsOutputEnum::kKeysPublicKey)) {
+    member("publicKeyHex");
+    appendUpper(buf, coin.publicKey());
+    buf += '"';
+  }
+  if (!first) buf += '}';
+  buf += "}\n";
+}
+
+void KeySerializer::json(std::string& buf, const CoinKeyPair& coin,
+                         ByteView label) const {
+  // array element at indent level 2, members at level 3 and 4
+  static const char* INDENT2 = "    ";
+  static const char* INDENT3 = "      ";
+  static const char* INDENT4 = "        ";
+  bool has_label = (hasLabel() && !label.empty());
+  bool has_key = options_.test(OptionsOutputEnum::kKeysAddress) ||
+                 options_.test(OptionsOutputEnum::kKeysPrivKey) ||
+                 options_.test(OptionsOutputEnum::kKeysPublicKey);
+  buf += INDENT2;
+  if (!has_label && !has_key) {
+    buf += "null";
+    return;
+  }
+  buf += "{\n";
+  if (has_label) {
+    buf += INDENT3;
+    appendName(buf, member_.c_str(), true);
+    appendJsonString(buf, label.data(), label.size());
+    buf += (has_key ? ",\n" : "\n");
+  }
+  if (has_key) {
+    buf += INDENT3;
+    appendName(buf, "key", true);
+    buf += "{\n";
+    bool first{true};
+    auto member = [&](const char* name) {
+      if (!first) buf += ",\n";
+      first = false;
+      buf += INDENT4;
+      appendName(buf, name, true);
+      buf += '"';
+    };
+    if (options_.test(OptionsOutputEnum::kKeysAddress)) {
+      member("address");
+      appendString(buf, coin.address());
+      buf += '"';
+    }
+    if (options_.test(OptionsOutputEnum::kKeysPrivKey)) {
+      member("privateKeyWif");
+      appendString(buf, coin.privateKey());
+      buf += '"';
+    }
+    if (options_.test(OptionsOutputEnum::kKeysPublicKey)) {
+      member("publicKeyHex");
+      appendUpper(buf, coin.publicKey());
+      buf += '"';
+    }
+    buf += '\n';
+    buf += INDENT3;
+    buf += "}\n";
+  }
+  buf += INDENT2;
+  buf += '}';
+}
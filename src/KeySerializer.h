@@ -0,0 +1,91 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KEYSERIALIZER_H
+#define KEYSERIALIZER_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "CoinKeyPair.h"
+#include "ByteView.h"
+
+/// key record fields included in command output
+enum OptionsOutputEnum : std::uint8_t {
+  kKeysAddress = 1,
+  kKeysPrivKey,
+  kKeysPublicKey,
+  kRootKey
+};
+
+using OptionsOutput = std::bitset<8>;
+
+/// \brief Appends hex encoding of data to buffer.
+void appendHex(std::string& buf, const uint8_t* data, size_t len,
+               bool upper = false);
+
+/// \brief Appends decimal representation of value to buffer.
+void appendUInt(std::string& buf, uint64_t value);
+
+/// \brief Appends string as quoted JSON string to buffer.
+void appendJsonString(std::string& buf, const uint8_t* data, size_t len);
+
+///
+/// \brief Serializes fixed shape key records directly into caller's buffer.
+///
+/// Output is identical to what nlohmann::json produces for the same record,
+/// but no intermediate json objects or strings are created. Once the buffer
+/// has grown to record size, serialization does not allocate memory.
+///
+/// Records may carry one string 'label' in addition to key, e.g. password
+/// of random keys or derivation path of HD wallet keys. In JSON records it
+/// is member "_<label>", in CSV records column "<label>".
+///
+class KeySerializer {
+ public:
+  KeySerializer(const OptionsOutput& options, const std::string& label = "")
+      : options_(options), label_(label), member_("_" + label) {}
+
+  /// \brief True when records carry label value.
+  bool hasLabel() const { return !label_.empty(); }
+
+  /// \brief Header row for CSV output.
+  void csvHeader(std::string& buf) const;
+
+  /// \brief Key record as CSV row, terminated by new line.
+  void csv(std::string& buf, uint64_t index, const CoinKeyPair& coin,
+           ByteView label) const;
+
+  /// \brief Key record as compact JSON object, terminated by new line.
+  void ndjson(std::string& buf, uint64_t index, const CoinKeyPair& coin,
+              ByteView label) const;
+
+  /// \brief Key record as element of "keys" array in a JSON document
+  /// pretty printed with indent of 2, without separator or new line.
+  void json(std::string& buf, const CoinKeyPair& coin, ByteView label) const;
+
+ private:
+  OptionsOutput options_;
+  std::string label_;   /// label name, empty if records have no label
+  std::string member_;  /// JSON member name of label
+};
+
+#endif  // KEYSERIALIZER_H
@@ -0,0 +1,115 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdexcept>
+
+#include "KeyWriter.h"
+#include "StageStats.h"
+
+namespace {
+/// buffer size that triggers flush
+const size_t FLUSH_SIZE{1 << 16};
+
+/// maximum time a record is kept in buffer
+const std::chrono::milliseconds FLUSH_INTERVAL{250};
+}
+
+KeyWriter::KeyWriter(std::ostream& out, OutputFormat format,
+                     const OptionsOutput& options, const std::string& label,
+                     const std::string& head)
+    : out_(out),
+      format_(format),
+      serializer_(options, label),
+      finished_(false),
+      count_(0),
+      flushed_(std::chrono::steady_clock::now()) {
+  if (format_ == OutputFormat::kBinary)
+    throw std::invalid_argument("KeyWriter::binary format is not text");
+  buf_.reserve(FLUSH_SIZE + 1024);
+  writeHeader(head);
+}
+
+KeyWriter::~KeyWriter() {
+  // document is left open if finish() was not called, e.g. on error
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+void KeyWriter::writeHeader(const std::string& head) {
+  if (format_ == OutputFormat::kCsv) {
+    serializer_.csvHeader(buf_);
+  } else if (format_ == OutputFormat::kJson) {
+    // open "keys" array in place of closing brace of document head
+    auto end = head.rfind('}');
+    if (end == std::string::npos)
+      throw std::invalid_argument("KeyWriter::invalid JSON document head");
+    end = head.find_last_not_of(" \n", end - 1);
+    bool empty = (head[end] == '{');
+    buf_.append(head, 0, end + 1);
+    buf_ += (empty ? "\n  \"keys\": [" : ",\n  \"keys\": [");
+  }
+}
+
+void KeyWriter::write(uint64_t index, const CoinKeyPair& coin,
+                      ByteView label) {
+  StageTimer timer(Stage::kSerialization);
+  if (!serializer_.hasLabel()) label = ByteView();
+  if (format_ == OutputFormat::kNdJson) {
+    serializer_.ndjson(buf_, index, coin, label);
+  } else if (format_ == OutputFormat::kCsv) {
+    serializer_.csv(buf_, index, coin, label);
+  } else {
+    buf_ += (count_ == 0 ? "\n" : ",\n");
+    serializer_.json(buf_, coin, label);
+  }
+  count_++;
+
+  if (buf_.size() >= FLUSH_SIZE ||
+      std::chrono::steady_clock::now() - flushed_ >= FLUSH_INTERVAL)
+    flush();
+}
+
+void KeyWriter::flush() {
+  if (!buf_.empty()) {
+    out_.write(buf_.data(), buf_.size());
+    buf_.clear();
+  }
+  out_.flush();
+  flushed_ = std::chrono::steady_clock::now();
+  if (!out_) throw std::runtime_error("KeyWriter::output stream write failed");
+}
+
+void KeyWriter::finish() { finish(""); }
+
+void KeyWriter::finish(const std::string& members) {
+  if (finished_) return;
+  StageTimer timer(Stage::kSerialization, 0);
+  finished_ = true;
+  if (format_ == OutputFormat::kJson) {
+    buf_ += (count_ == 0 ? "]" : "\n  ]");
+    if (!members.empty()) buf_ += ",\n" + members;
+    buf_ += "\n}\n";
+  } else if (format_ == OutputFormat::kNdJson && !members.empty()) {
+    buf_ += members + '\n';
+  }
+  flush();
+}
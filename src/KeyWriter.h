@@ -0,0 +1,105 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KEYWRITER_H
+#define KEYWRITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "CoinKeyPair.h"
+#include "KeySerializer.h"
+
+/// command output formats
+enum class OutputFormat {
+  kJson = 0,  /// single JSON document, key records in "keys" array
+  kNdJson,    /// one JSON key record per line, streamed
+  kCsv,       /// one comma separated key record per line, streamed
+  kBinary     /// fixed size records in binary export file
+};
+
+///
+/// \brief Destination of key records produced by bulk commands.
+///
+class KeySink {
+ public:
+  virtual ~KeySink() {}
+
+  /// \brief Writes key record, label is written only if not empty.
+  virtual void write(uint64_t index, const CoinKeyPair& coin,
+                     ByteView label = ByteView()) = 0;
+
+  /// \brief Completes output after last record.
+  virtual void finish() = 0;
+};
+
+///
+/// \brief Streams key records through a buffered writer.
+///
+/// Records are written as they are produced so memory use does not depend
+/// on key count. Buffer is flushed to output stream when it is full or
+/// when records have been waiting longer than flush interval.
+///
+/// With JSON format 'head' is the pretty printed document without key
+/// records, records are written into "keys" array appended to it. Records
+/// carry 'label' value when label name is given, see KeySerializer.
+///
+class KeyWriter : public KeySink {
+ public:
+  KeyWriter(std::ostream& out, OutputFormat format,
+            const OptionsOutput& options = OptionsOutput(0xff),
+            const std::string& label = "", const std::string& head = "");
+  virtual ~KeyWriter();
+
+  KeyWriter(const KeyWriter&) = delete;
+  KeyWriter& operator=(const KeyWriter&) = delete;
+
+  /// \brief Writes key record, label is written only if not empty.
+  void write(uint64_t index, const CoinKeyPair& coin,
+             ByteView label = ByteView()) override;
+
+  /// \brief Writes buffered records to output stream.
+  void flush();
+
+  /// \brief Terminates document and flushes output stream.
+  void finish() override;
+
+  /// \brief Terminates document with 'members' written after key records,
+  /// pretty printed members of JSON document or JSON line of ndjson.
+  void finish(const std::string& members);
+
+  /// \brief Number of records written.
+  uint64_t count() const { return count_; }
+
+ private:
+  void writeHeader(const std::string& head);
+
+  std::ostream& out_;
+  OutputFormat format_;
+  KeySerializer serializer_;
+  bool finished_;
+
+  std::string buf_;
+  uint64_t count_;
+  std::chrono::steady_clock::time_point flushed_;
+};
+
+#endif  // KEYWRITER_H
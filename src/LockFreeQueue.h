@@ -0,0 +1,173 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// \brief Rounds capacity up to power of two, at least 2.
+inline size_t queueCapacity(size_t n) {
+  size_t c = 2;
+  while (c < n) c <<= 1;
+  return c;
+}
+
+///
+/// \brief Bounded lock-free queue of one producer and one consumer thread.
+///
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity)
+      : mask_(queueCapacity(capacity) - 1),
+        cells_(mask_ + 1),
+        head_(0),
+        tail_(0) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /// \brief Moves item into queue, returns false if queue is full.
+  bool push(T& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+    cells_[tail & mask_] = std::move(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Moves oldest item out of queue, returns false if queue is empty.
+  bool pop(T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    item = std::move(cells_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Number of queued items, approximate while queue is in use.
+  size_t size() const {
+    return tail_.load(std::memory_order_relaxed) -
+           head_.load(std::memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  const size_t mask_;
+  std::vector<T> cells_;
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
+
+///
+/// \brief Bounded lock-free queue of any number of producer and consumer
+/// threads.
+///
+/// Every cell carries a sequence number telling whether it is free for the
+/// producer of its round or full for the consumer (D. Vyukov's bounded MPMC
+/// queue).
+///
+template <typename T>
+class MpmcQueue {
+ public:
+  explicit MpmcQueue(size_t capacity)
+      : mask_(queueCapacity(capacity) - 1),
+        cells_(mask_ + 1),
+        head_(0),
+        tail_(0) {
+    for (size_t i = 0; i <= mask_; i++)
+      cells_[i].seq_.store(i, std::memory_order_relaxed);
+  }
+
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  /// \brief Moves item into queue, returns false if queue is full.
+  bool push(T& item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells_[pos & mask_];
+      size_t seq = cell.seq_.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.value_ = std::move(item);
+          cell.seq_.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// \brief Moves oldest item out of queue, returns false if queue is empty.
+  bool pop(T& item) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells_[pos & mask_];
+      size_t seq = cell.seq_.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          item = std::move(cell.value_);
+          cell.seq_.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// \brief Number of queued items, approximate while queue is in use.
+  size_t size() const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_relaxed);
+    return (tail > head ? tail - head : 0);
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq_;
+    T value_;
+  };
+
+  const size_t mask_;
+  std::vector<Cell> cells_;
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
+
+#endif  // LOCKFREEQUEUE_H
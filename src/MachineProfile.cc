@@ -0,0 +1,148 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AtomicFile.h"
+#include "MachineProfile.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+const int FILE_VERSION{1};
+
+std::string hostName() {
+  char name[256] = {0};
+  if (::gethostname(name, sizeof(name) - 1) != 0) return "localhost";
+  return name;
+}
+
+/// \brief Value of first "key : value" line of proc file.
+std::string procValue(const char* file, const std::string& key) {
+  std::ifstream in(file);
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string name = line.substr(0, colon);
+    name.erase(name.find_last_not_of(" \t") + 1);
+    if (name != key) continue;
+    size_t begin = line.find_first_not_of(" \t", colon + 1);
+    return (begin == std::string::npos ? "" : line.substr(begin));
+  }
+  return "";
+}
+
+/// \brief Creates directories of 'path' up to its file name.
+void makeParents(const std::string& path) {
+  for (size_t pos = path.find('/', 1); pos != std::string::npos;
+       pos = path.find('/', pos + 1)) {
+    std::string dir = path.substr(0, pos);
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+      throw std::runtime_error("MachineProfile::mkdir " + dir + ": " +
+                               std::strerror(errno));
+  }
+}
+}
+
+MachineProfile::Machine MachineProfile::current() {
+  Machine m;
+  m.host_ = hostName();
+  m.cpu_ = procValue("/proc/cpuinfo", "model name");
+  m.cores_ = std::thread::hardware_concurrency();
+  std::string mem_kb = procValue("/proc/meminfo", "MemTotal");
+  m.memory_mb_ = std::strtoull(mem_kb.c_str(), nullptr, 10) >> 10;
+  return m;
+}
+
+std::string MachineProfile::defaultPath() {
+  std::string dir;
+  const char* config = std::getenv("XDG_CONFIG_HOME");
+  const char* home = std::getenv("HOME");
+  if (config != nullptr && *config != '\0')
+    dir = config;
+  else if (home != nullptr && *home != '\0')
+    dir = std::string(home) + "/.config";
+  else
+    return "";
+  return dir + "/warptool/" + hostName() + ".json";
+}
+
+MachineProfile::MachineProfile(const std::string& path)
+    : machine_(current()),
+      threads_(0),
+      interleave_(1),
+      huge_pages_("default"),
+      keys_per_second_(0),
+      path_(path) {}
+
+bool MachineProfile::load() {
+  std::ifstream in(path_);
+  if (!in) return false;
+  json doc;
+  try {
+    in >> doc;
+    if (!doc.is_object() || doc.value("version", 0) != FILE_VERSION)
+      throw std::runtime_error("version");
+    const json& m = doc.at("machine");
+    Machine machine;
+    machine.host_ = m.at("host").get<std::string>();
+    machine.cpu_ = m.at("cpu").get<std::string>();
+    machine.cores_ = m.at("cores").get<unsigned int>();
+    machine.memory_mb_ = m.value("memoryMB", uint64_t(0));
+    if (!(machine == current())) return false;
+    machine_ = machine;
+    threads_ = doc.at("threads").get<unsigned int>();
+    interleave_ = doc.at("interleave").get<unsigned int>();
+    if (threads_ == 0 || interleave_ == 0) throw std::runtime_error("zero");
+    kernel_ = doc.at("scryptKernel").get<std::string>();
+    huge_pages_ = doc.value("hugePages", std::string("default"));
+    keys_per_second_ = doc.value("keysPerSecond", 0.0);
+  } catch (std::exception&) {
+    throw std::runtime_error("MachineProfile::invalid profile file " + path_);
+  }
+  return true;
+}
+
+void MachineProfile::store() const {
+  json doc;
+  doc["version"] = FILE_VERSION;
+  doc["machine"] = {{"host", machine_.host_},
+                    {"cpu", machine_.cpu_},
+                    {"cores", machine_.cores_},
+                    {"memoryMB", machine_.memory_mb_}};
+  doc["threads"] = threads_;
+  doc["interleave"] = interleave_;
+  doc["scryptKernel"] = kernel_;
+  doc["hugePages"] = huge_pages_;
+  doc["keysPerSecond"] = keys_per_second_;
+
+  // write new file, then replace old one
+  makeParents(path_);
+  writeFileAtomic(path_, doc.dump(2) + "\n", 0644);
+}
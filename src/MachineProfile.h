@@ -0,0 +1,77 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MACHINEPROFILE_H
+#define MACHINEPROFILE_H
+
+#include <cstdint>
+#include <string>
+
+///
+/// \brief Tuned KDF engine settings of one machine.
+///
+/// Profile is written by tune command and read by bulk commands and daemon,
+/// settings given on command line take precedence. Profile written on other
+/// machine, e.g. on shared home directory, is not applied.
+///
+class MachineProfile {
+ public:
+  /// \brief Identity of machine.
+  struct Machine {
+    bool operator==(const Machine& other) const {
+      return (host_ == other.host_ && cpu_ == other.cpu_ &&
+              cores_ == other.cores_);
+    }
+    std::string host_;
+    std::string cpu_;      /// model name of first processor
+    unsigned int cores_;   /// hardware threads
+    uint64_t memory_mb_;  /// physical memory
+  };
+
+  /// \brief Machine running the process.
+  static Machine current();
+
+  /// \brief Profile of this machine in $XDG_CONFIG_HOME/warptool or in
+  /// ~/.config/warptool, empty if neither is known.
+  static std::string defaultPath();
+
+  explicit MachineProfile(const std::string& path);
+
+  /// \brief Reads profile, returns false if there is no file or it was
+  /// written on other machine. Throws std::runtime_error on invalid file.
+  bool load();
+
+  /// \brief Writes profile of current machine replacing old one, parent
+  /// directory is created when missing.
+  void store() const;
+
+  const std::string& path() const { return path_; }
+
+  Machine machine_;
+  unsigned int threads_;
+  unsigned int interleave_;
+  std::string kernel_;      /// scrypt kernel name
+  std::string huge_pages_;  /// default | on | off
+  double keys_per_second_;  /// calibrated KDF throughput
+
+ private:
+  std::string path_;
+};
+
+#endif  // MACHINEPROFILE_H
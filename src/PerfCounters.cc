@@ -0,0 +1,160 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include "PerfCounters.h"
+
+namespace {
+const char* EVENT_NAMES[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "llcMisses", "dtlbMisses", "stalledCycles"};
+
+/// \brief Config of hardware cache read miss event.
+uint64_t cacheMiss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+perf_event_attr eventAttr(size_t event) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // user mode only, allowed by default perf_event_paranoid 2
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  switch (static_cast<PerfEvent>(event)) {
+    case PerfEvent::kCycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PerfEvent::kInstructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PerfEvent::kLlcMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+      break;
+    case PerfEvent::kDtlbMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB);
+      break;
+    case PerfEvent::kStalledCycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+      break;
+  }
+  return attr;
+}
+
+/// errors of first thread opening counters, empty if event is counted
+std::mutex PROBE_MUTEX;
+bool PROBED{false};
+std::array<std::string, PERF_EVENT_COUNT> ERRORS;
+
+/// \brief Counter file descriptors of one thread.
+class ThreadCounters {
+ public:
+  ThreadCounters() : opened_(false), any_(false) { fds_.fill(-1); }
+  ~ThreadCounters() {
+    for (int fd : fds_)
+      if (fd >= 0) ::close(fd);
+  }
+
+  bool open() {
+    if (opened_) return any_;
+    opened_ = true;
+    std::array<std::string, PERF_EVENT_COUNT> errors;
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++) {
+      perf_event_attr attr = eventAttr(i);
+      fds_[i] = static_cast<int>(
+          ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fds_[i] >= 0)
+        any_ = true;
+      else
+        errors[i] = std::strerror(errno);
+    }
+    std::lock_guard<std::mutex> lock(PROBE_MUTEX);
+    if (!PROBED) {
+      PROBED = true;
+      ERRORS = errors;
+    }
+    return any_;
+  }
+
+  bool read(uint64_t* values) {
+    if (!open()) return false;
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++) {
+      values[i] = 0;
+      uint64_t v[3];  // value, time enabled, time running
+      if (fds_[i] < 0 || ::read(fds_[i], v, sizeof(v)) != sizeof(v))
+        continue;
+      values[i] = (v[2] == 0 || v[2] == v[1]
+                       ? v[0]
+                       : static_cast<uint64_t>(
+                             static_cast<double>(v[0]) * v[1] / v[2]));
+    }
+    return true;
+  }
+
+ private:
+  std::array<int, PERF_EVENT_COUNT> fds_;
+  bool opened_;
+  bool any_;
+};
+
+ThreadCounters& threadCounters() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+}
+
+bool PerfCounters::read(uint64_t* values) {
+  return threadCounters().read(values);
+}
+
+bool PerfCounters::probe() { return threadCounters().open(); }
+
+bool PerfCounters::probed() {
+  std::lock_guard<std::mutex> lock(PROBE_MUTEX);
+  return PROBED;
+}
+
+bool PerfCounters::available(PerfEvent event) {
+  std::lock_guard<std::mutex> lock(PROBE_MUTEX);
+  return PROBED && ERRORS[static_cast<int>(event)].empty();
+}
+
+std::string PerfCounters::error(PerfEvent event) {
+  std::lock_guard<std::mutex> lock(PROBE_MUTEX);
+  return ERRORS[static_cast<int>(event)];
+}
+
+const char* PerfCounters::name(PerfEvent event) {
+  return EVENT_NAMES[static_cast<int>(event)];
+}
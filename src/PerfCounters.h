@@ -0,0 +1,70 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// \brief Hardware events counted per thread.
+enum class PerfEvent : int {
+  kCycles = 0,     /// CPU cycles in user mode
+  kInstructions,   /// retired instructions
+  kLlcMisses,      /// last level cache read misses
+  kDtlbMisses,     /// data TLB read misses
+  kStalledCycles   /// cycles stalled in backend, e.g. waiting for memory
+};
+
+const size_t PERF_EVENT_COUNT{5};
+
+///
+/// \brief Per-thread hardware performance counters of perf_event_open(2).
+///
+/// Counters of a thread are opened on its first read and closed when the
+/// thread exits. Events are opened one by one, so an event the CPU or
+/// hypervisor does not support leaves the others counting. In containers
+/// the syscall is often blocked by seccomp or perf_event_paranoid, then
+/// reads return false and the error is reported by error().
+///
+class PerfCounters {
+ public:
+  /// \brief Reads counters of calling thread into 'values', events not
+  /// counted read as zero. Counts are scaled when the kernel multiplexes
+  /// counters. Returns false if no event could be opened.
+  static bool read(uint64_t* values);
+
+  /// \brief Opens counters of calling thread, returns true if at least one
+  /// event is counted.
+  static bool probe();
+
+  /// \brief Whether any thread has tried to open counters.
+  static bool probed();
+
+  /// \brief Whether event could be opened by the first thread.
+  static bool available(PerfEvent event);
+
+  /// \brief Error opening event, empty if event is counted or not probed.
+  static std::string error(PerfEvent event);
+
+  static const char* name(PerfEvent event);
+};
+
+#endif  // PERFCOUNTERS_H
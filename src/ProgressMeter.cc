@@ -0,0 +1,98 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "ProgressMeter.h"
+
+namespace {
+const std::chrono::seconds INTERVAL_TTY{1};
+const std::chrono::seconds INTERVAL_LOG{10};
+
+/// \brief Formats seconds as hh:mm:ss.
+void putDuration(std::ostream& out, double sec) {
+  auto s = static_cast<uint64_t>(sec);
+  out << std::setfill('0') << std::setw(2) << s / 3600 << ':' << std::setw(2)
+      << (s / 60) % 60 << ':' << std::setw(2) << s % 60 << std::setfill(' ');
+}
+}
+
+ProgressMeter::ProgressMeter(std::ostream& out, uint64_t total, bool enabled)
+    : out_(out),
+      total_(total),
+      done_(0),
+      enabled_(enabled),
+      tty_(&out == &std::cerr && isatty(STDERR_FILENO)),
+      finished_(false),
+      start_(std::chrono::steady_clock::now()),
+      reported_(start_) {}
+
+ProgressMeter::~ProgressMeter() { finish(); }
+
+double ProgressMeter::rate() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_;
+  return (elapsed.count() > 0 ? done_ / elapsed.count() : 0.0);
+}
+
+void ProgressMeter::add(uint64_t cnt) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_ += cnt;
+  if (!enabled_) return;
+  auto now = std::chrono::steady_clock::now();
+  if (now - reported_ >= (tty_ ? INTERVAL_TTY : INTERVAL_LOG)) {
+    reported_ = now;
+    report(false);
+  }
+}
+
+void ProgressMeter::finish() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!enabled_ || finished_) return;
+  finished_ = true;
+  report(true);
+}
+
+void ProgressMeter::report(bool last) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_;
+  double r = (elapsed.count() > 0 ? done_ / elapsed.count() : 0.0);
+
+  if (tty_) out_ << '\r';
+  out_ << "keys " << done_ << '/' << total_;
+  if (total_ != 0)
+    out_ << " (" << std::fixed << std::setprecision(1)
+         << 100.0 * done_ / total_ << "%)";
+  out_ << ' ' << std::fixed << std::setprecision(2) << r << " keys/s";
+  out_ << (last ? " time " : " elapsed ");
+  putDuration(out_, elapsed.count());
+  if (!last && r > 0 && done_ < total_) {
+    out_ << " eta ";
+    putDuration(out_, (total_ - done_) / r);
+  }
+  out_ << (tty_ && !last ? "   " : "\n");
+  out_.unsetf(std::ios::floatfield);
+  out_.flush();
+}
@@ -0,0 +1,62 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PROGRESSMETER_H
+#define PROGRESSMETER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+///
+/// \brief Reports progress, throughput and ETA of long running commands.
+///
+/// On a terminal the status line is rewritten in place, otherwise a new
+/// line is written at each report interval. Methods are thread safe.
+///
+class ProgressMeter {
+ public:
+  ProgressMeter(std::ostream& out, uint64_t total, bool enabled = true);
+  virtual ~ProgressMeter();
+
+  /// \brief Adds completed items and reports if interval has elapsed.
+  void add(uint64_t cnt = 1);
+
+  /// \brief Reports final status.
+  void finish();
+
+  /// \brief Completed items per second since start.
+  double rate() const;
+
+ private:
+  void report(bool last);
+
+  mutable std::mutex mutex_;
+  std::ostream& out_;
+  uint64_t total_;
+  uint64_t done_;
+  bool enabled_;
+  bool tty_;
+  bool finished_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point reported_;
+};
+
+#endif  // PROGRESSMETER_H
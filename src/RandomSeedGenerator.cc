@@ -99,7 +99,10 @@ bool RandomSeedGenerator::generatePassphrase(Passphrase& phrase,
 
   // init and then fill phrase with random words
   phrase.resize(cnt);
-  auto fill = [&](std::vector<uint8_t>& w) { w = words_.at(dist(*engine_)); };
+  auto fill = [&](Password& w) {
+    const auto& word = words_.at(dist(*engine_));
+    w.assign(word.begin(), word.end());
+  };
   std::for_each(phrase.begin(), phrase.end(), fill);
 
   return true;
@@ -29,6 +29,8 @@
 #include <memory>
 #include <random>
 
+#include "SecureMemory.h"
+
 enum class SeedChar {
   kUndef = 0,
   kAll,
@@ -40,7 +42,7 @@ enum class SeedChar {
 
 enum class SeedDictionary { kUndef = 0, kFinnish, kEnglish };
 
-using Password = std::vector<uint8_t>;
+using Password = SecureBytes;
 using Passphrase = std::vector<Password>;
 using RangeMinMax = std::pair<uint32_t, uint32_t>;
 using Dictionary = std::map<uint32_t, std::vector<uint8_t> >;
@@ -0,0 +1,252 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "hmac.h"
+#include "sha256.h"
+using namespace cppcrypto;
+
+#include "AtomicFile.h"
+#include "CoinEncoding.h"
+#include "KeySerializer.h"
+#include "RootKeyCache.h"
+#include "ScryptEngine.h"
+#include "SecureMemory.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+constexpr uint32_t RootKeyCache::kScryptLogN;
+constexpr uint32_t RootKeyCache::kScryptR;
+
+namespace {
+const char* KDF_NAME = "scrypt";
+
+/// upper bounds of KDF parameters read from file, a crafted entry must not
+/// make load() map gigabytes
+const uint32_t MAX_LOG_N{22};
+const uint32_t MAX_R{32};
+const std::string KDF_SALT_PREFIX("warpwallet-root-cache");
+const int FILE_VERSION{1};
+
+/// \brief Encryption and authentication keys derived from passphrase.
+struct CacheKeys {
+  ~CacheKeys() {
+    secureWipe(enc_, sizeof(enc_));
+    secureWipe(mac_, sizeof(mac_));
+  }
+  uint8_t enc_[32];
+  uint8_t mac_[32];
+};
+
+void deriveKeys(const Password& pwd, const Password& salt, uint32_t log_n,
+                uint32_t r, CacheKeys& keys) {
+  SecureBytes s(KDF_SALT_PREFIX.begin(), KDF_SALT_PREFIX.end());
+  s.insert(s.end(), salt.begin(), salt.end());
+  uint8_t dk[64];
+  // own arena, wiped and unmapped on return, not kept warm in pool
+  ScryptArena arena(uint64_t(1) << log_n, r);
+  scrypt(pwd.data(), pwd.size(), s.data(), s.size(), 1, dk, sizeof(dk),
+         arena);
+  std::copy(dk, dk + 32, keys.enc_);
+  std::copy(dk + 32, dk + 64, keys.mac_);
+  secureWipe(dk, sizeof(dk));
+}
+
+void hmacSha256(const uint8_t* key, const ByteVect& msg, uint8_t out[32]) {
+  hmac h(sha256(), key, 32);
+  h.init();
+  h.update(msg.data(), msg.size());
+  h.final(out);
+}
+
+/// \brief Entry identifier, hex of SHA-256(salt || network).
+std::string entryId(const Password& salt, CoinId id) {
+  ByteVect data(salt.begin(), salt.end());
+  data.push_back(static_cast<uint8_t>(id));
+  uint8_t digest[32];
+  sha256 h;
+  h.hash_string(data.data(), data.size(), digest);
+  std::string hex;
+  appendHex(hex, digest, sizeof(digest));
+  return hex;
+}
+
+/// \brief Tag over entry identifier, nonce and encrypted root.
+void entryTag(const CacheKeys& keys, const std::string& id,
+              const ByteVect& nonce, const ByteVect& cipher, uint8_t out[32]) {
+  ByteVect msg(id.begin(), id.end());
+  msg.insert(msg.end(), nonce.begin(), nonce.end());
+  msg.insert(msg.end(), cipher.begin(), cipher.end());
+  hmacSha256(keys.mac_, msg, out);
+}
+
+ByteVect fromHex(const json& v, size_t len) {
+  ByteVect out;
+  if (!v.is_string()) return out;
+  std::string s = v.get<std::string>();
+  if (!hexDecode(reinterpret_cast<const uint8_t*>(s.data()), s.size(), out) ||
+      out.size() != len)
+    out.clear();
+  return out;
+}
+
+std::string toHex(const uint8_t* data, size_t len) {
+  std::string hex;
+  appendHex(hex, data, len);
+  return hex;
+}
+
+/// \brief Reads cache file, missing file gives empty cache. Invalid file,
+/// e.g. truncated by a crash, is ignored and replaced by next store().
+json readFile(const std::string& path) {
+  json empty{{"version", FILE_VERSION}, {"entries", json::object()}};
+  std::ifstream in(path);
+  if (!in) return empty;
+  json doc;
+  try {
+    in >> doc;
+  } catch (std::exception&) {
+    doc = nullptr;
+  }
+  if (!doc.is_object() || doc.value("version", 0) != FILE_VERSION ||
+      !doc["entries"].is_object()) {
+    std::cerr << "RootKeyCache: ignoring invalid cache file " << path
+              << std::endl;
+    return empty;
+  }
+  return doc;
+}
+
+/// \brief Lock of cache file held for lifetime of object, shared by
+/// readers, exclusive for read-modify-write of store().
+class FileLock {
+ public:
+  FileLock(const std::string& path, int operation)
+      : fd_(::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                   0600)) {
+    if (fd_ < 0)
+      throw std::runtime_error("RootKeyCache::open " + path + ".lock: " +
+                               std::strerror(errno));
+    while (::flock(fd_, operation) != 0)
+      if (errno != EINTR) {
+        ::close(fd_);
+        throw std::runtime_error("RootKeyCache::lock " + path + ": " +
+                                 std::strerror(errno));
+      }
+  }
+  ~FileLock() { ::close(fd_); }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+ private:
+  int fd_;
+};
+}
+
+bool RootKeyCache::load(const Password& pwd, const Password& salt, CoinId id,
+                        SecretKey& root) const {
+  json doc;
+  {
+    FileLock lock(path_, LOCK_SH);
+    doc = readFile(path_);
+  }
+  std::string eid = entryId(salt, id);
+  auto it = doc["entries"].find(eid);
+  if (it == doc["entries"].end() || !it->is_object()) return false;
+  const json& entry = *it;
+  if (entry.value("kdf", "") != KDF_NAME) return false;
+  uint32_t log_n = entry.value("logN", 0u);
+  uint32_t r = entry.value("r", 0u);
+  ByteVect nonce = fromHex(entry["nonce"], 16);
+  ByteVect cipher = fromHex(entry["root"], 32);
+  ByteVect tag = fromHex(entry["tag"], 32);
+  // entries weaker than current parameters are not trusted
+  if (log_n < kScryptLogN || log_n > MAX_LOG_N || r < kScryptR ||
+      r > MAX_R || nonce.empty() || cipher.empty() || tag.empty())
+    return false;
+
+  CacheKeys keys;
+  deriveKeys(pwd, salt, log_n, r, keys);
+  uint8_t expected[32];
+  entryTag(keys, eid, nonce, cipher, expected);
+  uint8_t diff{0};
+  for (size_t i = 0; i < 32; i++) diff |= expected[i] ^ tag[i];
+  if (diff != 0) return false;
+
+  uint8_t stream[32];
+  hmacSha256(keys.enc_, nonce, stream);
+  for (size_t i = 0; i < 32; i++) root[i] = cipher[i] ^ stream[i];
+  secureWipe(stream, sizeof(stream));
+  return true;
+}
+
+void RootKeyCache::store(const Password& pwd, const Password& salt, CoinId id,
+                         const SecretKey& root) const {
+  // entries of concurrent writers, e.g. other batch jobs or processes, are
+  // not lost between reading and replacing the file
+  FileLock lock(path_, LOCK_EX);
+  json doc = readFile(path_);
+  std::string eid = entryId(salt, id);
+
+  // drop entries of older KDF, they are cheaper to attack
+  json& entries = doc["entries"];
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (!it->is_object() || it->value("kdf", "") != KDF_NAME)
+      it = entries.erase(it);
+    else
+      ++it;
+  }
+
+  ByteVect nonce(16);
+  std::random_device rd;
+  for (auto& b : nonce) b = static_cast<uint8_t>(rd());
+
+  CacheKeys keys;
+  deriveKeys(pwd, salt, kScryptLogN, kScryptR, keys);
+  uint8_t stream[32];
+  hmacSha256(keys.enc_, nonce, stream);
+  ByteVect cipher(32);
+  for (size_t i = 0; i < 32; i++) cipher[i] = root[i] ^ stream[i];
+  secureWipe(stream, sizeof(stream));
+  uint8_t tag[32];
+  entryTag(keys, eid, nonce, cipher, tag);
+
+  doc["entries"][eid] = {{"kdf", KDF_NAME},
+                         {"logN", kScryptLogN},
+                         {"r", kScryptR},
+                         {"nonce", toHex(nonce.data(), nonce.size())},
+                         {"root", toHex(cipher.data(), cipher.size())},
+                         {"tag", toHex(tag, sizeof(tag))}};
+
+  // write new file readable by owner only, then replace old one
+  writeFileAtomic(path_, doc.dump(2) + "\n", 0600);
+}
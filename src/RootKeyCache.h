@@ -0,0 +1,67 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef ROOTKEYCACHE_H
+#define ROOTKEYCACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "CoinKeyPair.h"
+#include "RandomSeedGenerator.h"
+
+///
+/// \brief Local file cache of wallet root keys encrypted by passphrase.
+///
+/// Entries are keyed by SHA-256 of (salt, network). Encryption and
+/// authentication keys are derived from passphrase and salt by scrypt,
+/// root key is encrypted by HMAC-SHA256 key stream with random nonce and
+/// authenticated by HMAC-SHA256 tag. Entry that fails verification, e.g.
+/// because of other passphrase, or uses weaker KDF parameters than the
+/// current ones is treated as missing.
+///
+/// Cache KDF is memory hard like WarpWallet but cheaper (N = 2^16, 64 MiB),
+/// otherwise a cache hit would save nothing. Guessing passphrase against
+/// the file costs about a quarter of a WarpWallet key. Cache file is
+/// created readable by owner only. Processes sharing the file serialize
+/// updates by flock() of "<file>.lock", an invalid file is treated as empty.
+///
+class RootKeyCache {
+ public:
+  static constexpr uint32_t kScryptLogN{16};
+  static constexpr uint32_t kScryptR{8};
+
+  explicit RootKeyCache(const std::string& path) : path_(path) {}
+
+  /// \brief Reads root key of (salt, network), returns false if there is
+  /// no entry or it does not verify with passphrase.
+  bool load(const Password& pwd, const Password& salt, CoinId id,
+            SecretKey& root) const;
+
+  /// \brief Stores root key of (salt, network) replacing old entry.
+  void store(const Password& pwd, const Password& salt, CoinId id,
+             const SecretKey& root) const;
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+#endif  // ROOTKEYCACHE_H
@@ -0,0 +1,479 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "CancelToken.h"
+#include "ScryptEngine.h"
+#include "SecureMemory.h"
+#include "Sha256Engine.h"
+
+namespace {
+/// ROMix blocks between polls of cancel token
+const uint64_t CANCEL_INTERVAL{4096};
+
+inline uint32_t rol(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+inline uint32_t loadLE(const uint8_t* p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+inline void storeLE(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+/// Salsa20/8 core, b = b + salsa(b)
+void salsa208(uint32_t* b) {
+  uint32_t x[16];
+  std::copy(b, b + 16, x);
+  for (int i = 0; i < 8; i += 2) {
+    x[4] ^= rol(x[0] + x[12], 7);
+    x[8] ^= rol(x[4] + x[0], 9);
+    x[12] ^= rol(x[8] + x[4], 13);
+    x[0] ^= rol(x[12] + x[8], 18);
+    x[9] ^= rol(x[5] + x[1], 7);
+    x[13] ^= rol(x[9] + x[5], 9);
+    x[1] ^= rol(x[13] + x[9], 13);
+    x[5] ^= rol(x[1] + x[13], 18);
+    x[14] ^= rol(x[10] + x[6], 7);
+    x[2] ^= rol(x[14] + x[10], 9);
+    x[6] ^= rol(x[2] + x[14], 13);
+    x[10] ^= rol(x[6] + x[2], 18);
+    x[3] ^= rol(x[15] + x[11], 7);
+    x[7] ^= rol(x[3] + x[15], 9);
+    x[11] ^= rol(x[7] + x[3], 13);
+    x[15] ^= rol(x[11] + x[7], 18);
+    x[1] ^= rol(x[0] + x[3], 7);
+    x[2] ^= rol(x[1] + x[0], 9);
+    x[3] ^= rol(x[2] + x[1], 13);
+    x[0] ^= rol(x[3] + x[2], 18);
+    x[6] ^= rol(x[5] + x[4], 7);
+    x[7] ^= rol(x[6] + x[5], 9);
+    x[4] ^= rol(x[7] + x[6], 13);
+    x[5] ^= rol(x[4] + x[7], 18);
+    x[11] ^= rol(x[10] + x[9], 7);
+    x[8] ^= rol(x[11] + x[10], 9);
+    x[9] ^= rol(x[8] + x[11], 13);
+    x[10] ^= rol(x[9] + x[8], 18);
+    x[12] ^= rol(x[15] + x[14], 7);
+    x[13] ^= rol(x[12] + x[15], 9);
+    x[14] ^= rol(x[13] + x[12], 13);
+    x[15] ^= rol(x[14] + x[13], 18);
+  }
+  for (int i = 0; i < 16; i++) b[i] += x[i];
+}
+
+/// BlockMix of 2 * r blocks from 'in' to 'out', odd blocks to second half
+void blockMix(const uint32_t* in, uint32_t* out, uint32_t r) {
+  uint32_t x[16];
+  std::copy(in + 16 * (2 * r - 1), in + 32 * r, x);
+  for (uint32_t i = 0; i < 2 * r; i++) {
+    for (int k = 0; k < 16; k++) x[k] ^= in[16 * i + k];
+    salsa208(x);
+    std::copy(x, x + 16, out + 16 * ((i & 1) * r + i / 2));
+  }
+}
+
+#ifdef __SSE2__
+/// Salsa20/8 core on one block of SSE2 layout, b = b + salsa(b)
+void salsa208Sse2(__m128i* b) {
+  __m128i x0 = b[0], x1 = b[1], x2 = b[2], x3 = b[3];
+  __m128i t;
+  for (int i = 0; i < 8; i += 2) {
+    // columns
+    t = _mm_add_epi32(x0, x3);
+    x1 = _mm_xor_si128(x1, _mm_slli_epi32(t, 7));
+    x1 = _mm_xor_si128(x1, _mm_srli_epi32(t, 25));
+    t = _mm_add_epi32(x1, x0);
+    x2 = _mm_xor_si128(x2, _mm_slli_epi32(t, 9));
+    x2 = _mm_xor_si128(x2, _mm_srli_epi32(t, 23));
+    t = _mm_add_epi32(x2, x1);
+    x3 = _mm_xor_si128(x3, _mm_slli_epi32(t, 13));
+    x3 = _mm_xor_si128(x3, _mm_srli_epi32(t, 19));
+    t = _mm_add_epi32(x3, x2);
+    x0 = _mm_xor_si128(x0, _mm_slli_epi32(t, 18));
+    x0 = _mm_xor_si128(x0, _mm_srli_epi32(t, 14));
+    x1 = _mm_shuffle_epi32(x1, 0x93);
+    x2 = _mm_shuffle_epi32(x2, 0x4e);
+    x3 = _mm_shuffle_epi32(x3, 0x39);
+
+    // rows
+    t = _mm_add_epi32(x0, x1);
+    x3 = _mm_xor_si128(x3, _mm_slli_epi32(t, 7));
+    x3 = _mm_xor_si128(x3, _mm_srli_epi32(t, 25));
+    t = _mm_add_epi32(x3, x0);
+    x2 = _mm_xor_si128(x2, _mm_slli_epi32(t, 9));
+    x2 = _mm_xor_si128(x2, _mm_srli_epi32(t, 23));
+    t = _mm_add_epi32(x2, x3);
+    x1 = _mm_xor_si128(x1, _mm_slli_epi32(t, 13));
+    x1 = _mm_xor_si128(x1, _mm_srli_epi32(t, 19));
+    t = _mm_add_epi32(x1, x2);
+    x0 = _mm_xor_si128(x0, _mm_slli_epi32(t, 18));
+    x0 = _mm_xor_si128(x0, _mm_srli_epi32(t, 14));
+    x1 = _mm_shuffle_epi32(x1, 0x39);
+    x2 = _mm_shuffle_epi32(x2, 0x4e);
+    x3 = _mm_shuffle_epi32(x3, 0x93);
+  }
+  b[0] = _mm_add_epi32(b[0], x0);
+  b[1] = _mm_add_epi32(b[1], x1);
+  b[2] = _mm_add_epi32(b[2], x2);
+  b[3] = _mm_add_epi32(b[3], x3);
+}
+
+/// BlockMix in SSE2 layout, 4 vectors per block
+void blockMixSse2(const __m128i* in, __m128i* out, uint32_t r) {
+  __m128i x[4];
+  std::copy(in + 4 * (2 * r - 1), in + 8 * r, x);
+  for (uint32_t i = 0; i < 2 * r; i++) {
+    for (int k = 0; k < 4; k++) x[k] = _mm_xor_si128(x[k], in[4 * i + k]);
+    salsa208Sse2(x);
+    std::copy(x, x + 4, out + 4 * ((i & 1) * r + i / 2));
+  }
+}
+
+/// Position of word k in SSE2 layout, words of each block are stored
+/// diagonals first so that salsa rounds work on whole vectors. First word
+/// of a block keeps its place, integerify reads the same word.
+inline size_t sse2Index(size_t k) { return (k & ~size_t(15)) + (k * 5 & 15); }
+
+#endif
+
+ScryptKernel bestKernel() {
+#ifdef __SSE2__
+  return ScryptKernel::kSse2;
+#else
+  return ScryptKernel::kScalar;
+#endif
+}
+
+/// kernel of ROMix, set by setScryptKernel()
+std::atomic<int> KERNEL{static_cast<int>(bestKernel())};
+
+/// Scalar kernel, words in natural order
+struct ScalarKernel {
+  static size_t index(size_t k) { return k; }
+  static void mix(const uint32_t* in, uint32_t* out, uint32_t r) {
+    blockMix(in, out, r);
+  }
+  static void xorBlock(uint32_t* x, const uint32_t* v, size_t words) {
+    for (size_t k = 0; k < words; k++) x[k] ^= v[k];
+  }
+};
+
+#ifdef __SSE2__
+/// SSE2 kernel, arena memory is page aligned and blocks are 128 * r bytes
+struct Sse2Kernel {
+  static size_t index(size_t k) { return sse2Index(k); }
+  static void mix(const uint32_t* in, uint32_t* out, uint32_t r) {
+    blockMixSse2(reinterpret_cast<const __m128i*>(in),
+                 reinterpret_cast<__m128i*>(out), r);
+  }
+  static void xorBlock(uint32_t* x, const uint32_t* v, size_t words) {
+    __m128i* xv = reinterpret_cast<__m128i*>(x);
+    const __m128i* vv = reinterpret_cast<const __m128i*>(v);
+    for (size_t k = 0; k < words / 4; k++)
+      xv[k] = _mm_xor_si128(xv[k], vv[k]);
+  }
+};
+#endif
+
+/// Requests block of V into cache
+inline void prefetchBlock(const uint32_t* block, size_t words) {
+  const char* p = reinterpret_cast<const char*>(block);
+  for (size_t off = 0; off < words * 4; off += 64) __builtin_prefetch(p + off);
+}
+
+///
+/// ROMix of 'lanes' independent blocks, each lane has its own arena. Lanes
+/// advance in turns, so that the random V reads of one lane are fetched
+/// while the other lanes compute. With one lane this is plain ROMix.
+///
+template <class Kernel>
+void roMixLanes(uint8_t* const* blocks, ScryptArena* const* arenas,
+                size_t lanes, const CancelToken* cancel) {
+  const uint64_t N = arenas[0]->N();
+  const uint32_t r = arenas[0]->r();
+  const size_t words = 32 * r;
+
+  for (size_t l = 0; l < lanes; l++) {
+    uint32_t* x = arenas[l]->work();
+    for (size_t k = 0; k < words; k++)
+      x[k] = loadLE(blocks[l] + 4 * Kernel::index(k));
+  }
+  for (uint64_t i = 0; i < N; i += 2) {
+    if (cancel != nullptr && i % CANCEL_INTERVAL == 0) cancel->check();
+    for (size_t l = 0; l < lanes; l++) {
+      uint32_t* v = arenas[l]->table();
+      uint32_t* x = arenas[l]->work();
+      uint32_t* y = x + words;
+      std::copy(x, x + words, v + i * words);
+      Kernel::mix(x, y, r);
+      std::copy(y, y + words, v + (i + 1) * words);
+      Kernel::mix(y, x, r);
+    }
+  }
+  for (uint64_t i = 0; i < N; i += 2) {
+    if (cancel != nullptr && i % CANCEL_INTERVAL == 0) cancel->check();
+    for (size_t l = 0; l < lanes; l++) {
+      const uint32_t* v = arenas[l]->table();
+      uint32_t* x = arenas[l]->work();
+      uint32_t* y = x + words;
+      uint64_t j = x[words - 16] & (N - 1);
+      Kernel::xorBlock(x, v + j * words, words);
+      Kernel::mix(x, y, r);
+      j = y[words - 16] & (N - 1);
+      Kernel::xorBlock(y, v + j * words, words);
+      Kernel::mix(y, x, r);
+      // next block of this lane is read after the other lanes' turns
+      if (lanes > 1)
+        prefetchBlock(v + (x[words - 16] & (N - 1)) * words, words);
+    }
+  }
+  for (size_t l = 0; l < lanes; l++) {
+    const uint32_t* x = arenas[l]->work();
+    for (size_t k = 0; k < words; k++)
+      storeLE(blocks[l] + 4 * Kernel::index(k), x[k]);
+  }
+}
+
+void roMix(uint8_t* const* blocks, ScryptArena* const* arenas, size_t lanes,
+           ScryptKernel kernel, const CancelToken* cancel) {
+#ifdef __SSE2__
+  if (kernel == ScryptKernel::kSse2)
+    return roMixLanes<Sse2Kernel>(blocks, arenas, lanes, cancel);
+#endif
+  roMixLanes<ScalarKernel>(blocks, arenas, lanes, cancel);
+}
+}  // namespace
+
+std::vector<ScryptKernel> scryptKernels() {
+  std::vector<ScryptKernel> kernels{ScryptKernel::kScalar};
+#ifdef __SSE2__
+  kernels.push_back(ScryptKernel::kSse2);
+#endif
+  return kernels;
+}
+
+ScryptKernel scryptKernel() { return static_cast<ScryptKernel>(KERNEL.load()); }
+
+void setScryptKernel(ScryptKernel kernel) {
+  std::vector<ScryptKernel> kernels = scryptKernels();
+  if (std::find(kernels.begin(), kernels.end(), kernel) == kernels.end())
+    throw std::invalid_argument("setScryptKernel::kernel not available");
+  KERNEL = static_cast<int>(kernel);
+}
+
+const char* scryptKernelName(ScryptKernel kernel) {
+  switch (kernel) {
+    case ScryptKernel::kSse2:
+      return "sse2";
+    default:
+      return "scalar";
+  }
+}
+
+void scryptRoMix(uint8_t* block, ScryptArena& arena, ScryptKernel kernel,
+                 const CancelToken* cancel) {
+  ScryptArena* arenas[] = {&arena};
+  roMix(&block, arenas, 1, kernel, cancel);
+}
+
+void scryptBlockMix(ScryptArena& arena, ScryptKernel kernel, size_t count) {
+  const uint32_t r = arena.r();
+  uint32_t* x = arena.work();
+  uint32_t* y = x + 32 * r;
+  for (size_t i = 0; i < count; i++) {
+#ifdef __SSE2__
+    if (kernel == ScryptKernel::kSse2) {
+      Sse2Kernel::mix(x, y, r);
+      std::swap(x, y);
+      continue;
+    }
+#endif
+    ScalarKernel::mix(x, y, r);
+    std::swap(x, y);
+  }
+}
+
+ScryptArena::ScryptArena(uint64_t N, uint32_t r, HugePages huge)
+    : N_(N), r_(r), huge_(huge) {
+  if (N < 2 || (N & (N - 1)) != 0 || r == 0)
+    throw std::invalid_argument("ScryptArena::invalid parameters");
+  table_words_ = static_cast<size_t>(N) * 32 * r;
+  size_ = (table_words_ + 64 * r) * sizeof(uint32_t);
+  // table is locked when RLIMIT_MEMLOCK allows, never dumped, huge pages
+  // cut TLB misses of random V reads where kernel provides them
+  int advice = MADV_NORMAL;
+  if (huge == HugePages::kOn) advice = MADV_HUGEPAGE;
+  if (huge == HugePages::kOff) advice = MADV_NOHUGEPAGE;
+  try {
+    v_ = static_cast<uint32_t*>(SecurePool::map(size_, locked_, advice));
+  } catch (std::bad_alloc&) {
+    throw std::runtime_error("ScryptArena::memory allocation failed");
+  }
+}
+
+ScryptArena::~ScryptArena() { SecurePool::unmap(v_, size_, locked_); }
+
+void ScryptArena::prefault() {
+  const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  volatile uint8_t* p = reinterpret_cast<uint8_t*>(v_);
+  for (size_t i = 0; i < size_; i += page) p[i] = 0;
+}
+
+void ScryptArena::wipe() { secureWipe(v_, size_); }
+
+ScryptArenaPool& ScryptArenaPool::instance() {
+  static ScryptArenaPool pool;
+  return pool;
+}
+
+ScryptArenaPool::Lease ScryptArenaPool::acquire(uint64_t N, uint32_t r) {
+  std::unique_ptr<ScryptArena> arena;
+  ScryptArena::HugePages huge;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    huge = huge_;
+    auto it = std::find_if(idle_.begin(), idle_.end(),
+                           [N, r](const std::unique_ptr<ScryptArena>& a) {
+                             return a->N() == N && a->r() == r;
+                           });
+    if (it != idle_.end()) {
+      arena = std::move(*it);
+      idle_.erase(it);
+    }
+  }
+  if (!arena) arena.reset(new ScryptArena(N, r, huge));
+  return Lease(arena.release(), [this](ScryptArena* a) { release(a); });
+}
+
+void ScryptArenaPool::reserve(size_t count, uint64_t N, uint32_t r,
+                              bool prefault) {
+  std::vector<std::unique_ptr<ScryptArena>> arenas;
+  const ScryptArena::HugePages huge = hugePages();
+  for (size_t i = 0; i < count; i++) {
+    arenas.emplace_back(new ScryptArena(N, r, huge));
+    if (prefault) arenas.back()->prefault();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& a : arenas) idle_.push_back(std::move(a));
+}
+
+size_t ScryptArenaPool::idle() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_.size();
+}
+
+void ScryptArenaPool::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.clear();
+}
+
+void ScryptArenaPool::setHugePages(ScryptArena::HugePages huge) {
+  std::vector<std::unique_ptr<ScryptArena>> stale;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    huge_ = huge;
+    auto it = std::partition(idle_.begin(), idle_.end(),
+                             [huge](const std::unique_ptr<ScryptArena>& a) {
+                               return a->hugePages() == huge;
+                             });
+    std::move(it, idle_.end(), std::back_inserter(stale));
+    idle_.erase(it, idle_.end());
+  }
+}
+
+ScryptArena::HugePages ScryptArenaPool::hugePages() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return huge_;
+}
+
+void ScryptArenaPool::release(ScryptArena* arena) {
+  std::unique_ptr<ScryptArena> a(arena);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // arenas leased before a huge page change are not reused
+  if (a->hugePages() == huge_) idle_.push_back(std::move(a));
+}
+
+void scrypt(const uint8_t* pwd, size_t pwd_len, const uint8_t* salt,
+            size_t salt_len, uint32_t p, uint8_t* out, size_t out_len,
+            ScryptArena& arena, const CancelToken* cancel) {
+  HmacSha256 prf(pwd, pwd_len);
+  scrypt(prf, ByteView(salt, salt_len), ByteView(), p, out, out_len, arena,
+         cancel);
+}
+
+void scrypt(HmacSha256& prf, ByteView salt, ByteView salt_suffix, uint32_t p,
+            uint8_t* out, size_t out_len, ScryptArena& arena,
+            const CancelToken* cancel) {
+  if (p == 0) throw std::invalid_argument("scrypt::invalid parameters");
+  const size_t block_len = 128 * arena.r();
+  SecureBytes b(block_len * p);
+  prf.pbkdf2(salt, salt_suffix, 1, b.data(), b.size());
+  try {
+    for (uint32_t i = 0; i < p; i++)
+      scryptRoMix(b.data() + i * block_len, arena, scryptKernel(), cancel);
+  } catch (OperationCancelled&) {
+    // no intermediate state is left behind for the next lease
+    arena.wipe();
+    throw;
+  }
+  prf.pbkdf2(b.data(), b.size(), 1, out, out_len);
+}
+
+void scrypt(HmacSha256* const* prfs, ByteView salt, ByteView salt_suffix,
+            uint8_t* const* outs, size_t out_len, ScryptArena* const* arenas,
+            size_t lanes, const CancelToken* cancel) {
+  if (lanes == 0 || lanes > SCRYPT_MAX_LANES)
+    throw std::invalid_argument("scrypt::invalid lane count");
+  for (size_t l = 1; l < lanes; l++)
+    if (arenas[l]->N() != arenas[0]->N() || arenas[l]->r() != arenas[0]->r())
+      throw std::invalid_argument("scrypt::lane parameters differ");
+  const size_t block_len = 128 * arenas[0]->r();
+  SecureBytes b(block_len * lanes);
+  uint8_t* blocks[SCRYPT_MAX_LANES];
+  for (size_t l = 0; l < lanes; l++) {
+    blocks[l] = b.data() + l * block_len;
+    prfs[l]->pbkdf2(salt, salt_suffix, 1, blocks[l], block_len);
+  }
+  try {
+    roMix(blocks, arenas, lanes, scryptKernel(), cancel);
+  } catch (OperationCancelled&) {
+    for (size_t l = 0; l < lanes; l++) arenas[l]->wipe();
+    throw;
+  }
+  for (size_t l = 0; l < lanes; l++)
+    prfs[l]->pbkdf2(blocks[l], block_len, 1, outs[l], out_len);
+}
@@ -0,0 +1,181 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SCRYPTENGINE_H
+#define SCRYPTENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ByteView.h"
+
+class CancelToken;
+class HmacSha256;
+
+///
+/// \brief Scratch memory of one scrypt computation.
+///
+/// Holds the N * 128 * r byte ROMix table and block mix buffers. Memory
+/// is mapped once and reused by later computations, so only the first
+/// computation pays for page faults. Memory is excluded from core dumps,
+/// locked in RAM when the limit allows and wiped before unmapping.
+///
+class ScryptArena {
+ public:
+  /// \brief Transparent huge pages of arena memory.
+  enum class HugePages { kDefault = 0, kOn, kOff };
+
+  ScryptArena(uint64_t N, uint32_t r, HugePages huge = HugePages::kDefault);
+  ~ScryptArena();
+
+  ScryptArena(const ScryptArena&) = delete;
+  ScryptArena& operator=(const ScryptArena&) = delete;
+
+  uint64_t N() const { return N_; }
+  uint32_t r() const { return r_; }
+
+  /// \brief Bytes of mapped memory.
+  size_t size() const { return size_; }
+
+  HugePages hugePages() const { return huge_; }
+
+  /// \brief ROMix table V, N blocks of 32 * r words.
+  uint32_t* table() { return v_; }
+
+  /// \brief Block mix buffers X and Y, 32 * r words each.
+  uint32_t* work() { return v_ + table_words_; }
+
+  /// \brief Touches every page so that later use does not fault.
+  void prefault();
+
+  /// \brief Overwrites memory with zeros.
+  void wipe();
+
+ private:
+  uint64_t N_;
+  uint32_t r_;
+  size_t table_words_;
+  size_t size_;
+  uint32_t* v_;
+  bool locked_;      /// memory locked in RAM
+  HugePages huge_;  /// huge page advice of memory
+};
+
+///
+/// \brief Pool of idle scrypt arenas shared by worker threads.
+///
+/// acquire() returns an idle arena of the same parameters or maps a new
+/// one. Arena is returned to the pool when its lease is destroyed.
+///
+class ScryptArenaPool {
+ public:
+  using Lease = std::unique_ptr<ScryptArena, std::function<void(ScryptArena*)>>;
+
+  /// \brief Pool of the process.
+  static ScryptArenaPool& instance();
+
+  /// \brief Leases an arena for parameters N and r.
+  Lease acquire(uint64_t N, uint32_t r);
+
+  /// \brief Maps and optionally prefaults 'count' idle arenas.
+  void reserve(size_t count, uint64_t N, uint32_t r, bool prefault);
+
+  /// \brief Number of idle arenas in pool.
+  size_t idle() const;
+
+  /// \brief Wipes and unmaps idle arenas.
+  void clear();
+
+  /// \brief Huge page advice of arenas mapped later, drops idle arenas of
+  /// other advice.
+  void setHugePages(ScryptArena::HugePages huge);
+
+  ScryptArena::HugePages hugePages() const;
+
+ private:
+  ScryptArenaPool() {}
+  void release(ScryptArena* arena);
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<ScryptArena>> idle_;
+  ScryptArena::HugePages huge_{ScryptArena::HugePages::kDefault};
+};
+
+/// maximum scrypt computations interleaved in one thread
+const size_t SCRYPT_MAX_LANES{4};
+
+/// \brief Salsa20/8 implementation of ROMix.
+///
+/// SSE2 kernel keeps the words of each block diagonals first, so that the
+/// four salsa quarter rounds run on whole vectors.
+enum class ScryptKernel { kScalar = 0, kSse2 };
+
+/// \brief Kernels compiled in, best last.
+std::vector<ScryptKernel> scryptKernels();
+
+/// \brief Kernel used by scrypt(), best available by default.
+ScryptKernel scryptKernel();
+
+/// \brief Selects kernel of later scrypt() calls, throws
+/// std::invalid_argument when kernel is not available.
+void setScryptKernel(ScryptKernel kernel);
+
+const char* scryptKernelName(ScryptKernel kernel);
+
+/// \brief ROMix of one 128 * r byte block in place using given kernel.
+void scryptRoMix(uint8_t* block, ScryptArena& arena, ScryptKernel kernel,
+                 const CancelToken* cancel = nullptr);
+
+/// \brief Runs 'count' BlockMix rounds on arena work buffers, for
+/// benchmarks.
+void scryptBlockMix(ScryptArena& arena, ScryptKernel kernel, size_t count);
+
+///
+/// \brief scrypt key derivation (RFC 7914) using HMAC-SHA256 PBKDF2.
+///
+/// ROMix polls 'cancel' every 4096 blocks. When it fires, the arena is
+/// wiped and OperationCancelled is thrown.
+///
+void scrypt(const uint8_t* pwd, size_t pwd_len, const uint8_t* salt,
+            size_t salt_len, uint32_t p, uint8_t* out, size_t out_len,
+            ScryptArena& arena, const CancelToken* cancel = nullptr);
+
+///
+/// \brief scrypt keyed by password MAC 'prf', salt is concatenation of salt
+/// and suffix.
+///
+void scrypt(HmacSha256& prf, ByteView salt, ByteView salt_suffix, uint32_t p,
+            uint8_t* out, size_t out_len, ScryptArena& arena,
+            const CancelToken* cancel = nullptr);
+
+///
+/// \brief scrypt with p = 1 of 'lanes' passwords, each keyed by its MAC in
+/// 'prfs', with own arena and output. ROMix of the lanes is interleaved in
+/// calling thread, so that memory latency of one lane is hidden by the
+/// work of the others. Arenas must have equal parameters.
+///
+void scrypt(HmacSha256* const* prfs, ByteView salt, ByteView salt_suffix,
+            uint8_t* const* outs, size_t out_len, ScryptArena* const* arenas,
+            size_t lanes, const CancelToken* cancel = nullptr);
+
+#endif  // SCRYPTENGINE_H
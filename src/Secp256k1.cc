@@ -0,0 +1,504 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "Secp256k1.h"
+#include "StageStats.h"
+
+using Field = Secp256k1::Field;
+using Point = Secp256k1::Point;
+using PointJ = Secp256k1::PointJ;
+
+namespace {
+/// field prime p = 2^256 - 2^32 - 977
+const Field P = {{0xFFFFFC2F, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+                  0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}};
+
+/// group order n
+const uint32_t N[8] = {0xD0364141, 0xBFD25E8C, 0xAF48A03B, 0xBAAEDCE6,
+                       0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+
+const Point G = {
+    {{0x16F81798, 0x59F2815B, 0x2DCE28D9, 0x029BFCDB, 0xCE870B07, 0x55A06295,
+      0xF9DCBBAC, 0x79BE667E}},
+    {{0xFB10D4B8, 0x9C47D08F, 0xA6855419, 0xFD17B448, 0x0E1108A8, 0x5DA4FBFC,
+      0x26A3C465, 0x483ADA77}},
+    false};
+
+/// curve constant b of y^2 = x^3 + b
+const Field B = {{7, 0, 0, 0, 0, 0, 0, 0}};
+
+/// scalar of offset point of generator multiplication, SHA-256 of
+/// "warpwallet-tool generator offset", its discrete log relation to table
+/// points is unknown
+const uint8_t OFFSET[32] = {
+    0xF2, 0xA5, 0xCB, 0x2C, 0x35, 0x27, 0x02, 0xE3, 0xEA, 0xCC, 0x94,
+    0x86, 0xCD, 0x95, 0xD9, 0x9E, 0xBC, 0x15, 0xCA, 0xF1, 0x67, 0x85,
+    0xB5, 0x91, 0x1C, 0xDF, 0x8D, 0x21, 0xF9, 0xB1, 0xF5, 0xC3};
+
+// --- 256-bit helpers, little-endian 32-bit limbs ---
+
+void load(const uint8_t* in, uint32_t* r) {
+  for (int i = 0; i < 8; i++) {
+    const uint8_t* b = in + 28 - 4 * i;
+    r[i] = uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 |
+           uint32_t(b[3]);
+  }
+}
+
+void store(const uint32_t* a, uint8_t* out) {
+  for (int i = 0; i < 8; i++) {
+    uint8_t* b = out + 28 - 4 * i;
+    b[0] = uint8_t(a[i] >> 24);
+    b[1] = uint8_t(a[i] >> 16);
+    b[2] = uint8_t(a[i] >> 8);
+    b[3] = uint8_t(a[i]);
+  }
+}
+
+/// \brief Compares a and b, returns -1, 0 or 1.
+int compare(const uint32_t* a, const uint32_t* b) {
+  for (int i = 7; i >= 0; i--) {
+    if (a[i] != b[i]) return (a[i] < b[i] ? -1 : 1);
+  }
+  return 0;
+}
+
+/// \brief r = a + b, returns carry.
+uint32_t add256(const uint32_t* a, const uint32_t* b, uint32_t* r) {
+  uint64_t c = 0;
+  for (int i = 0; i < 8; i++) {
+    c += uint64_t(a[i]) + b[i];
+    r[i] = uint32_t(c);
+    c >>= 32;
+  }
+  return uint32_t(c);
+}
+
+/// \brief r = a - b, returns borrow.
+uint32_t sub256(const uint32_t* a, const uint32_t* b, uint32_t* r) {
+  int64_t c = 0;
+  for (int i = 0; i < 8; i++) {
+    c += int64_t(a[i]) - b[i];
+    r[i] = uint32_t(c);
+    c >>= 32;
+  }
+  return uint32_t(c != 0);
+}
+
+bool isZero(const uint32_t* a) {
+  uint32_t z = 0;
+  for (int i = 0; i < 8; i++) z |= a[i];
+  return z == 0;
+}
+
+// --- field arithmetic modulo p ---
+
+Field feAdd(const Field& a, const Field& b) {
+  Field r;
+  uint32_t carry = add256(a.n_, b.n_, r.n_);
+  if (carry || compare(r.n_, P.n_) >= 0) sub256(r.n_, P.n_, r.n_);
+  return r;
+}
+
+Field feSub(const Field& a, const Field& b) {
+  Field r;
+  if (sub256(a.n_, b.n_, r.n_)) add256(r.n_, P.n_, r.n_);
+  return r;
+}
+
+#ifdef __SIZEOF_INT128__
+/// \brief Product with 64-bit limbs, reduced using 2^256 = 0x1000003d1.
+Field feMul(const Field& a, const Field& b) {
+  using uint128_t = unsigned __int128;
+  const uint64_t K = 0x1000003D1ULL;
+  uint64_t x[4], y[4], t[8] = {0};
+  for (int i = 0; i < 4; i++) {
+    x[i] = a.n_[2 * i] | uint64_t(a.n_[2 * i + 1]) << 32;
+    y[i] = b.n_[2 * i] | uint64_t(b.n_[2 * i + 1]) << 32;
+  }
+  for (int i = 0; i < 4; i++) {
+    uint64_t carry = 0;
+    for (int j = 0; j < 4; j++) {
+      uint128_t c = uint128_t(x[i]) * y[j] + t[i + j] + carry;
+      t[i + j] = uint64_t(c);
+      carry = uint64_t(c >> 64);
+    }
+    t[i + 4] = carry;
+  }
+
+  uint64_t r[4];
+  uint128_t c = 0;
+  for (int i = 0; i < 4; i++) {
+    c += uint128_t(t[4 + i]) * K + t[i];
+    r[i] = uint64_t(c);
+    c >>= 64;
+  }
+  // fold bits above 2^256 once more, carry out leaves small value
+  c = uint128_t(uint64_t(c)) * K + r[0];
+  r[0] = uint64_t(c);
+  c >>= 64;
+  for (int i = 1; i < 4; i++) {
+    c += r[i];
+    r[i] = uint64_t(c);
+    c >>= 64;
+  }
+  if (c != 0) r[0] += K;
+
+  Field f;
+  for (int i = 0; i < 4; i++) {
+    f.n_[2 * i] = uint32_t(r[i]);
+    f.n_[2 * i + 1] = uint32_t(r[i] >> 32);
+  }
+  if (compare(f.n_, P.n_) >= 0) sub256(f.n_, P.n_, f.n_);
+  return f;
+}
+#else
+/// \brief Reduces 512-bit product t modulo p using 2^256 = 2^32 + 977.
+Field feReduce(const uint32_t* t) {
+  Field r;
+  uint64_t c = 0;
+  for (int i = 0; i < 8; i++) {
+    c += uint64_t(t[i]) + uint64_t(t[8 + i]) * 977 + (i > 0 ? t[7 + i] : 0);
+    r.n_[i] = uint32_t(c);
+    c >>= 32;
+  }
+  c += t[15];
+
+  // fold bits above 2^256 once more
+  uint64_t hi = c;
+  c = uint64_t(r.n_[0]) + hi * 977;
+  r.n_[0] = uint32_t(c);
+  c >>= 32;
+  c += uint64_t(r.n_[1]) + hi;
+  r.n_[1] = uint32_t(c);
+  c >>= 32;
+  for (int i = 2; i < 8; i++) {
+    c += r.n_[i];
+    r.n_[i] = uint32_t(c);
+    c >>= 32;
+  }
+  if (c != 0) {
+    // result wrapped past 2^256 and is small now, add 2^32 + 977
+    const Field fold = {{977, 1, 0, 0, 0, 0, 0, 0}};
+    add256(r.n_, fold.n_, r.n_);
+  }
+  if (compare(r.n_, P.n_) >= 0) sub256(r.n_, P.n_, r.n_);
+  return r;
+}
+
+Field feMul(const Field& a, const Field& b) {
+  uint32_t t[16] = {0};
+  for (int i = 0; i < 8; i++) {
+    uint64_t c = 0;
+    for (int j = 0; j < 8; j++) {
+      c += uint64_t(a.n_[i]) * b.n_[j] + t[i + j];
+      t[i + j] = uint32_t(c);
+      c >>= 32;
+    }
+    t[i + 8] = uint32_t(c);
+  }
+  return feReduce(t);
+}
+#endif
+
+Field feSqr(const Field& a) { return feMul(a, a); }
+
+Field feSqrN(Field a, int n) {
+  while (n-- > 0) a = feSqr(a);
+  return a;
+}
+
+Field feDouble(const Field& a) { return feAdd(a, a); }
+
+bool feIsZero(const Field& a) { return isZero(a.n_); }
+
+bool feEqual(const Field& a, const Field& b) {
+  return compare(a.n_, b.n_) == 0;
+}
+
+/// \brief Common prefix of inversion and square root addition chains,
+/// returns a^(2^223 - 1) and intermediate powers x2 and x22.
+Field fePow223(const Field& a, Field& x2, Field& x22) {
+  x2 = feMul(feSqr(a), a);
+  Field x3 = feMul(feSqr(x2), a);
+  Field x6 = feMul(feSqrN(x3, 3), x3);
+  Field x9 = feMul(feSqrN(x6, 3), x3);
+  Field x11 = feMul(feSqrN(x9, 2), x2);
+  x22 = feMul(feSqrN(x11, 11), x11);
+  Field x44 = feMul(feSqrN(x22, 22), x22);
+  Field x88 = feMul(feSqrN(x44, 44), x44);
+  Field x176 = feMul(feSqrN(x88, 88), x88);
+  Field x220 = feMul(feSqrN(x176, 44), x44);
+  return feMul(feSqrN(x220, 3), x3);
+}
+
+/// \brief Returns a^(p-2) = 1/a.
+Field feInv(const Field& a) {
+  Field x2, x22;
+  Field t = fePow223(a, x2, x22);
+  t = feMul(feSqrN(t, 23), x22);
+  t = feMul(feSqrN(t, 5), a);
+  t = feMul(feSqrN(t, 3), x2);
+  return feMul(feSqrN(t, 2), a);
+}
+
+/// \brief Returns a^((p+1)/4), square root of a if one exists.
+Field feSqrt(const Field& a) {
+  Field x2, x22;
+  Field t = fePow223(a, x2, x22);
+  t = feMul(feSqrN(t, 23), x22);
+  t = feMul(feSqrN(t, 6), x2);
+  return feSqrN(t, 2);
+}
+
+// --- generator multiplication table ---
+
+/// \brief Copies 'a' into 'r' when mask is all ones, keeps 'r' when mask
+/// is zero, without branching on mask.
+void feSelect(uint32_t mask, const Field& a, Field& r) {
+  for (int i = 0; i < 8; i++) r.n_[i] ^= mask & (r.n_[i] ^ a.n_[i]);
+}
+
+/// \brief TABLE[i][j] = (j + 1) * 16^i * G for 64 windows of 4 bits, and
+/// offset point O = OFFSET * G and its negation.
+struct GeneratorTable {
+  GeneratorTable() : points_(64 * 15) {
+    std::vector<PointJ> jac(64 * 15);
+    PointJ base = {G.x_, G.y_, {{1, 0, 0, 0, 0, 0, 0, 0}}, false};
+    for (int i = 0; i < 64; i++) {
+      Point base_affine = Secp256k1::toAffine(base);
+      PointJ acc = base;
+      jac[i * 15] = acc;
+      for (int j = 1; j < 15; j++) {
+        acc = Secp256k1::add(acc, base_affine);
+        jac[i * 15 + j] = acc;
+      }
+      for (int k = 0; k < 4; k++) base = Secp256k1::twice(base);
+    }
+    Secp256k1::toAffine(jac.data(), points_.data(), jac.size());
+
+    // offset scalar is public, variable time is fine here
+    PointJ o;
+    o.infinity_ = true;
+    for (int w = 0; w < 64; w++) {
+      int nibble = (OFFSET[31 - w / 2] >> (4 * (w % 2))) & 0x0f;
+      if (nibble != 0) o = Secp256k1::add(o, at(w, nibble));
+    }
+    offset_ = Secp256k1::toAffine(o);
+    neg_offset_ = offset_;
+    neg_offset_.y_ = feSub(Field{{0}}, offset_.y_);
+  }
+
+  const Point& at(int window, int nibble) const {
+    return points_[window * 15 + nibble - 1];
+  }
+
+  std::vector<Point> points_;
+  Point offset_;
+  Point neg_offset_;
+};
+
+const GeneratorTable& generatorTable() {
+  static const GeneratorTable table;
+  return table;
+}
+}
+
+bool Secp256k1::isBelowOrder(const uint8_t* k) {
+  uint32_t a[8];
+  load(k, a);
+  return compare(a, N) < 0;
+}
+
+bool Secp256k1::isValidSecret(const uint8_t* k) {
+  uint32_t a[8];
+  load(k, a);
+  return !isZero(a) && compare(a, N) < 0;
+}
+
+bool Secp256k1::scalarAdd(const uint8_t* a, const uint8_t* b, uint8_t* r) {
+  uint32_t x[8], y[8], z[8];
+  load(a, x);
+  load(b, y);
+  uint32_t carry = add256(x, y, z);
+  if (carry || compare(z, N) >= 0) sub256(z, N, z);
+  store(z, r);
+  return !isZero(z);
+}
+
+void Secp256k1::scalarReduce(const uint8_t* a, uint8_t* r) {
+  // any 256-bit value is below 2n, one subtraction is enough
+  uint32_t x[8];
+  load(a, x);
+  if (compare(x, N) >= 0) sub256(x, N, x);
+  store(x, r);
+}
+
+const Point& Secp256k1::generator() { return G; }
+
+PointJ Secp256k1::twice(const PointJ& a) {
+  if (a.infinity_ || feIsZero(a.y_)) {
+    PointJ r = a;
+    r.infinity_ = true;
+    return r;
+  }
+  // dbl-2009-l
+  Field A = feSqr(a.x_);
+  Field Bq = feSqr(a.y_);
+  Field C = feSqr(Bq);
+  Field D = feDouble(feSub(feSub(feSqr(feAdd(a.x_, Bq)), A), C));
+  Field E = feAdd(feDouble(A), A);
+  Field F = feSqr(E);
+  PointJ r;
+  r.infinity_ = false;
+  r.x_ = feSub(F, feDouble(D));
+  Field C8 = feDouble(feDouble(feDouble(C)));
+  r.y_ = feSub(feMul(E, feSub(D, r.x_)), C8);
+  r.z_ = feDouble(feMul(a.y_, a.z_));
+  return r;
+}
+
+PointJ Secp256k1::add(const PointJ& a, const Point& b) {
+  if (b.infinity_) return a;
+  if (a.infinity_) return {b.x_, b.y_, {{1, 0, 0, 0, 0, 0, 0, 0}}, false};
+
+  // madd-2007-bl
+  Field Z1Z1 = feSqr(a.z_);
+  Field U2 = feMul(b.x_, Z1Z1);
+  Field S2 = feMul(b.y_, feMul(a.z_, Z1Z1));
+  Field H = feSub(U2, a.x_);
+  Field R = feDouble(feSub(S2, a.y_));
+  if (feIsZero(H)) {
+    if (feIsZero(R)) return twice(a);
+    PointJ r = a;
+    r.infinity_ = true;
+    return r;
+  }
+  Field HH = feSqr(H);
+  Field I = feDouble(feDouble(HH));
+  Field J = feMul(H, I);
+  Field V = feMul(a.x_, I);
+  PointJ r;
+  r.infinity_ = false;
+  r.x_ = feSub(feSub(feSqr(R), J), feDouble(V));
+  r.y_ = feSub(feMul(R, feSub(V, r.x_)), feDouble(feMul(a.y_, J)));
+  r.z_ = feSub(feSub(feSqr(feAdd(a.z_, H)), Z1Z1), HH);
+  return r;
+}
+
+PointJ Secp256k1::multiplyG(const uint8_t* k) {
+  const GeneratorTable& table = generatorTable();
+  StageTimer timer(Stage::kEc);
+  // sum starts at offset O, so it is never infinity and every window adds
+  // a table point whatever the scalar, O is subtracted at the end
+  PointJ r = {table.offset_.x_, table.offset_.y_,
+              {{1, 0, 0, 0, 0, 0, 0, 0}}, false};
+  // byte 31 holds the lowest 8 bits of big-endian scalar
+  for (int w = 0; w < 64; w++) {
+    uint32_t nibble = (k[31 - w / 2] >> (4 * (w % 2))) & 0x0f;
+    // all 15 entries are read, zero nibble adds entry 1 as dummy
+    Point p = table.at(w, 1);
+    for (uint32_t j = 2; j <= 15; j++) {
+      uint32_t mask = 0 - uint32_t(j == nibble);
+      feSelect(mask, table.at(w, j).x_, p.x_);
+      feSelect(mask, table.at(w, j).y_, p.y_);
+    }
+    PointJ sum = add(r, p);
+    uint32_t keep = 0 - uint32_t(nibble != 0);
+    feSelect(keep, sum.x_, r.x_);
+    feSelect(keep, sum.y_, r.y_);
+    feSelect(keep, sum.z_, r.z_);
+    r.infinity_ = (sum.infinity_ & (nibble != 0)) |
+                  (r.infinity_ & (nibble == 0));
+  }
+  return add(r, table.neg_offset_);
+}
+
+Point Secp256k1::toAffine(const PointJ& a) {
+  Point r;
+  toAffine(&a, &r, 1);
+  return r;
+}
+
+void Secp256k1::toAffine(const PointJ* in, Point* out, size_t cnt) {
+  // time of keys is counted by multiplyG
+  StageTimer timer(Stage::kEc, 0);
+  // Montgomery's trick, prefix products of Z coordinates
+  std::vector<Field> prefix(cnt);
+  Field acc = {{1, 0, 0, 0, 0, 0, 0, 0}};
+  for (size_t i = 0; i < cnt; i++) {
+    prefix[i] = acc;
+    if (!in[i].infinity_) acc = feMul(acc, in[i].z_);
+  }
+  Field inv = feInv(acc);
+  for (size_t i = cnt; i-- > 0;) {
+    if (in[i].infinity_) {
+      out[i].infinity_ = true;
+      continue;
+    }
+    Field zinv = feMul(inv, prefix[i]);
+    inv = feMul(inv, in[i].z_);
+    Field zinv2 = feSqr(zinv);
+    out[i].x_ = feMul(in[i].x_, zinv2);
+    out[i].y_ = feMul(in[i].y_, feMul(zinv2, zinv));
+    out[i].infinity_ = false;
+  }
+}
+
+size_t Secp256k1::serialize(const Point& p, bool compressed, uint8_t* out) {
+  if (compressed) {
+    out[0] = (p.y_.n_[0] & 1 ? 0x03 : 0x02);
+    store(p.x_.n_, out + 1);
+    return 33;
+  }
+  out[0] = 0x04;
+  store(p.x_.n_, out + 1);
+  store(p.y_.n_, out + 33);
+  return 65;
+}
+
+bool Secp256k1::parse(const uint8_t* in, size_t len, Point& out) {
+  bool compressed = (len == 33 && (in[0] == 0x02 || in[0] == 0x03));
+  if (!compressed && !(len == 65 && in[0] == 0x04)) return false;
+  load(in + 1, out.x_.n_);
+  if (compare(out.x_.n_, P.n_) >= 0) return false;
+  out.infinity_ = false;
+
+  // y^2 = x^3 + 7
+  Field y2 = feAdd(feMul(feSqr(out.x_), out.x_), B);
+  if (compressed) {
+    out.y_ = feSqrt(y2);
+    if (!feEqual(feSqr(out.y_), y2)) return false;
+    if ((out.y_.n_[0] & 1) != (in[0] & 1u)) out.y_ = feSub(Field{{0}}, out.y_);
+    return true;
+  }
+  load(in + 33, out.y_.n_);
+  if (compare(out.y_.n_, P.n_) >= 0) return false;
+  return feEqual(feSqr(out.y_), y2);
+}
+
+size_t Secp256k1::publicKey(const uint8_t* secret, bool compressed,
+                            uint8_t* out) {
+  if (!isValidSecret(secret)) return 0;
+  return serialize(toAffine(multiplyG(secret)), compressed, out);
+}
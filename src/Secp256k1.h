@@ -0,0 +1,103 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SECP256K1_H
+#define SECP256K1_H
+
+#include <cstddef>
+#include <cstdint>
+
+///
+/// \brief Arithmetic of secp256k1 elliptic curve used by coin keys.
+///
+/// Field elements are kept fully reduced in eight 32-bit little-endian
+/// limbs. Multiplication of generator point uses precomputed table of
+/// 4-bit windows, so one public key costs 65 point additions and one field
+/// inversion. It reads every table entry of a window and adds one point per
+/// window whatever the secret, so neither branches nor table addresses
+/// depend on secret bits. Field arithmetic and the other operations are
+/// variable time, they are intended for key generation on local machine.
+///
+class Secp256k1 {
+ public:
+  /// \brief Field element modulo p.
+  struct Field {
+    uint32_t n_[8];
+  };
+
+  /// \brief Point in affine coordinates.
+  struct Point {
+    Field x_;
+    Field y_;
+    bool infinity_;
+  };
+
+  /// \brief Point in Jacobian coordinates, x = X / Z^2, y = Y / Z^3.
+  struct PointJ {
+    Field x_;
+    Field y_;
+    Field z_;
+    bool infinity_;
+  };
+
+  /// \brief Checks that 32-byte big-endian scalar is in range [1, n-1].
+  static bool isValidSecret(const uint8_t* k);
+
+  /// \brief Checks that 32-byte big-endian scalar is less than n.
+  static bool isBelowOrder(const uint8_t* k);
+
+  /// \brief r = (a + b) mod n, returns false if result is zero.
+  static bool scalarAdd(const uint8_t* a, const uint8_t* b, uint8_t* r);
+
+  /// \brief r = a mod n for any 32-byte big-endian value a.
+  static void scalarReduce(const uint8_t* a, uint8_t* r);
+
+  /// \brief Generator point G.
+  static const Point& generator();
+
+  /// \brief Returns k * G.
+  static PointJ multiplyG(const uint8_t* k);
+
+  /// \brief Returns a + b.
+  static PointJ add(const PointJ& a, const Point& b);
+
+  /// \brief Returns 2 * a.
+  static PointJ twice(const PointJ& a);
+
+  /// \brief Converts point into affine coordinates.
+  static Point toAffine(const PointJ& a);
+
+  /// \brief Converts points into affine coordinates sharing one field
+  /// inversion between all of them.
+  static void toAffine(const PointJ* in, Point* out, size_t cnt);
+
+  /// \brief Serializes point, 33 bytes compressed or 65 bytes uncompressed.
+  static size_t serialize(const Point& p, bool compressed, uint8_t* out);
+
+  /// \brief Parses compressed or uncompressed point, verifies that point is
+  /// on the curve.
+  static bool parse(const uint8_t* in, size_t len, Point& out);
+
+  /// \brief Computes public key of secret, returns serialized length or 0
+  /// if secret is not valid.
+  static size_t publicKey(const uint8_t* secret, bool compressed,
+                          uint8_t* out);
+};
+
+#endif  // SECP256K1_H
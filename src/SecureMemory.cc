@@ -0,0 +1,136 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <sys/mman.h>
+#include <cstring>
+
+#include "SecureMemory.h"
+
+namespace {
+const size_t MIN_BLOCK{16};
+const size_t MAX_BLOCK{4096};
+
+/// \brief Size class of block, 0 for 16 bytes.
+size_t sizeClass(size_t size) {
+  size_t c = 0;
+  for (size_t b = MIN_BLOCK; b < size; b <<= 1) c++;
+  return c;
+}
+}
+
+void secureWipe(void* p, size_t len) {
+  if (p == nullptr || len == 0) return;
+  // memset uses the widest vector stores of the CPU
+  std::memset(p, 0, len);
+  // keep compiler from dropping the store before release
+  __asm__ __volatile__("" : : "r"(p) : "memory");
+}
+
+SecurePool& SecurePool::instance() {
+  // never destroyed, blocks may be released by other static destructors
+  static SecurePool* pool = new SecurePool();
+  return *pool;
+}
+
+SecurePool::SecurePool() : locked_(0), mapped_(0) {
+  for (size_t i = 0; i < CLASSES; i++) free_[i] = nullptr;
+}
+
+void* SecurePool::map(size_t size, bool& locked, int advice) {
+  void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_DONTDUMP
+  ::madvise(p, size, MADV_DONTDUMP);
+#endif
+  if (advice != MADV_NORMAL) ::madvise(p, size, advice);
+  locked = (::mlock(p, size) == 0);
+  return p;
+}
+
+void SecurePool::unmap(void* p, size_t size, bool locked) {
+  secureWipe(p, size);
+  if (locked) ::munlock(p, size);
+  ::munmap(p, size);
+}
+
+void* SecurePool::allocate(size_t size) {
+  if (size == 0) size = 1;
+  if (size > MAX_BLOCK) {
+    // own mapping, its lock state is kept in a header block
+    bool locked;
+    uint8_t* p = static_cast<uint8_t*>(map(size + MIN_BLOCK, locked));
+    *p = locked;
+    std::lock_guard<std::mutex> lock(mutex_);
+    mapped_ += size + MIN_BLOCK;
+    if (locked) locked_ += size + MIN_BLOCK;
+    return p + MIN_BLOCK;
+  }
+
+  const size_t c = sizeClass(size);
+  const size_t block = MIN_BLOCK << c;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_[c] == nullptr) {
+    // carve a new chunk into blocks of this class
+    bool locked;
+    uint8_t* chunk = static_cast<uint8_t*>(map(CHUNK, locked));
+    mapped_ += CHUNK;
+    if (locked) locked_ += CHUNK;
+    for (size_t off = CHUNK; off >= block; off -= block) {
+      FreeBlock* b = reinterpret_cast<FreeBlock*>(chunk + off - block);
+      b->next_ = free_[c];
+      free_[c] = b;
+    }
+  }
+  FreeBlock* b = free_[c];
+  free_[c] = b->next_;
+  b->next_ = nullptr;
+  return b;
+}
+
+void SecurePool::release(void* p, size_t size) {
+  if (p == nullptr) return;
+  if (size == 0) size = 1;
+  if (size > MAX_BLOCK) {
+    uint8_t* base = static_cast<uint8_t*>(p) - MIN_BLOCK;
+    bool locked = (*base != 0);
+    unmap(base, size + MIN_BLOCK, locked);
+    std::lock_guard<std::mutex> lock(mutex_);
+    mapped_ -= size + MIN_BLOCK;
+    if (locked) locked_ -= size + MIN_BLOCK;
+    return;
+  }
+
+  const size_t c = sizeClass(size);
+  secureWipe(p, MIN_BLOCK << c);
+  std::lock_guard<std::mutex> lock(mutex_);
+  FreeBlock* b = static_cast<FreeBlock*>(p);
+  b->next_ = free_[c];
+  free_[c] = b;
+}
+
+size_t SecurePool::lockedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return locked_;
+}
+
+size_t SecurePool::mappedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return mapped_;
+}
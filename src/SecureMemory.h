@@ -0,0 +1,124 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SECUREMEMORY_H
+#define SECUREMEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/// \brief Overwrites 'len' bytes at 'p' with zeros, the stores are not
+/// removed by the compiler even when memory is released next.
+void secureWipe(void* p, size_t len);
+
+///
+/// \brief Pool of locked memory for secrets.
+///
+/// Memory is mapped in chunks that are locked in RAM (mlock) and excluded
+/// from core dumps (MADV_DONTDUMP). Blocks of 16 .. 4096 bytes are carved
+/// from chunks into power of two size classes and kept in free lists, so
+/// allocate and release are O(1) and never return memory to the system.
+/// Larger blocks get their own mapping. Every block is wiped on release.
+///
+/// Locking is best effort: when RLIMIT_MEMLOCK is reached memory is still
+/// excluded from core dumps and wiped, lockedBytes() tells how much is
+/// locked.
+///
+class SecurePool {
+ public:
+  /// \brief Pool of the process.
+  static SecurePool& instance();
+
+  /// \brief Allocates 'size' bytes, throws std::bad_alloc.
+  void* allocate(size_t size);
+
+  /// \brief Wipes and releases block allocated with given size.
+  void release(void* p, size_t size);
+
+  /// \brief Bytes of mapped memory that is locked in RAM.
+  size_t lockedBytes() const;
+
+  /// \brief Bytes of mapped memory.
+  size_t mappedBytes() const;
+
+  /// \brief Maps 'size' bytes excluded from core dumps, 'locked' tells
+  /// if they are locked in RAM. Madvise 'advice' is applied before pages
+  /// are locked, e.g. MADV_HUGEPAGE. Throws std::bad_alloc.
+  static void* map(size_t size, bool& locked, int advice = 0);
+
+  /// \brief Wipes, unlocks and unmaps memory of map().
+  static void unmap(void* p, size_t size, bool locked);
+
+ private:
+  SecurePool();
+
+  static const size_t CLASSES{9};          /// 16 .. 4096 bytes
+  static const size_t CHUNK{64 * 1024};    /// bytes mapped at once
+
+  struct FreeBlock {
+    FreeBlock* next_;
+  };
+
+  mutable std::mutex mutex_;
+  FreeBlock* free_[CLASSES];
+  size_t locked_;
+  size_t mapped_;
+};
+
+///
+/// \brief Standard allocator on SecurePool.
+///
+template <class T>
+class SecureAllocator {
+ public:
+  using value_type = T;
+
+  SecureAllocator() noexcept {}
+  template <class U>
+  SecureAllocator(const SecureAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n) {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+      throw std::bad_alloc();
+    return static_cast<T*>(SecurePool::instance().allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    SecurePool::instance().release(p, n * sizeof(T));
+  }
+};
+
+template <class T, class U>
+bool operator==(const SecureAllocator<T>&, const SecureAllocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const SecureAllocator<T>&, const SecureAllocator<U>&) {
+  return false;
+}
+
+/// \brief Bytes of passwords, salts and key material.
+using SecureBytes = std::vector<uint8_t, SecureAllocator<uint8_t>>;
+
+#endif  // SECUREMEMORY_H
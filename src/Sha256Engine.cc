@@ -0,0 +1,259 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "CancelToken.h"
+#include "SecureMemory.h"
+#include "Sha256Engine.h"
+
+const size_t Sha256::kSize;
+const size_t Sha256::kBlockSize;
+
+namespace {
+/// PBKDF2 iterations between polls of cancel token
+const uint32_t CANCEL_INTERVAL{4096};
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+const uint32_t IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+inline uint32_t ror(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline uint32_t loadBE(const uint8_t* p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 |
+         p[3];
+}
+
+inline void storeBE(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+void storeState(const uint32_t* state, uint8_t* out) {
+  for (int i = 0; i < 8; i++) storeBE(out + 4 * i, state[i]);
+}
+
+/// \brief Padded block of 32-byte message following one 64-byte block.
+void padDigestBlock(uint8_t* block) {
+  block[32] = 0x80;
+  std::fill(block + 33, block + 62, 0);
+  block[62] = 0x03;  // (64 + 32) * 8 = 768 bits
+  block[63] = 0x00;
+}
+}
+
+void Sha256::init() {
+  std::copy(std::begin(IV), std::end(IV), state_);
+  buf_len_ = 0;
+  total_ = 0;
+}
+
+void Sha256::compress(uint32_t* state, const uint8_t* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) w[i] = loadBE(block + 4 * i);
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) +
+                  ((e & f) ^ (~e & g)) + K[i] + w[i];
+    uint32_t t2 =
+        (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+void Sha256::update(const uint8_t* data, size_t len) {
+  total_ += len;
+  if (buf_len_ > 0) {
+    size_t n = std::min(len, kBlockSize - buf_len_);
+    std::memcpy(buf_ + buf_len_, data, n);
+    buf_len_ += n;
+    data += n;
+    len -= n;
+    if (buf_len_ < kBlockSize) return;
+    compress(state_, buf_);
+    buf_len_ = 0;
+  }
+  for (; len >= kBlockSize; data += kBlockSize, len -= kBlockSize)
+    compress(state_, data);
+  std::memcpy(buf_, data, len);
+  buf_len_ = len;
+}
+
+void Sha256::final(uint8_t* out) {
+  uint64_t bits = total_ * 8;
+  uint8_t pad = 0x80;
+  update(&pad, 1);
+  pad = 0;
+  while (buf_len_ != 56) update(&pad, 1);
+  uint8_t len[8];
+  for (int i = 0; i < 8; i++)
+    len[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+  update(len, sizeof(len));
+  storeState(state_, out);
+}
+
+void Sha256::hash(const uint8_t* data, size_t len, uint8_t* out) {
+  Sha256 h;
+  h.update(data, len);
+  h.final(out);
+}
+
+HmacSha256::HmacSha256(ByteView key, ByteView suffix) {
+  uint8_t k[Sha256::kBlockSize] = {0};
+  if (key.size() + suffix.size() > Sha256::kBlockSize) {
+    Sha256 h;
+    h.update(key);
+    h.update(suffix);
+    h.final(k);
+  } else {
+    std::copy(suffix.begin(), suffix.end(),
+              std::copy(key.begin(), key.end(), k));
+  }
+
+  uint8_t pad[Sha256::kBlockSize];
+  for (size_t i = 0; i < Sha256::kBlockSize; i++) pad[i] = k[i] ^ 0x36;
+  std::copy(std::begin(IV), std::end(IV), inner_);
+  Sha256::compress(inner_, pad);
+  for (size_t i = 0; i < Sha256::kBlockSize; i++) pad[i] = k[i] ^ 0x5c;
+  std::copy(std::begin(IV), std::end(IV), outer_);
+  Sha256::compress(outer_, pad);
+  secureWipe(k, sizeof(k));
+  secureWipe(pad, sizeof(pad));
+  init();
+}
+
+HmacSha256::~HmacSha256() {
+  secureWipe(&inner_, sizeof(inner_));
+  secureWipe(&outer_, sizeof(outer_));
+  secureWipe(&ctx_, sizeof(ctx_));
+}
+
+void HmacSha256::init() {
+  std::copy(std::begin(inner_), std::end(inner_), ctx_.state_);
+  ctx_.buf_len_ = 0;
+  ctx_.total_ = Sha256::kBlockSize;
+}
+
+void HmacSha256::update(const uint8_t* data, size_t len) {
+  ctx_.update(data, len);
+}
+
+void HmacSha256::final(uint8_t* out) {
+  uint8_t block[Sha256::kBlockSize];
+  ctx_.final(block);
+  padDigestBlock(block);
+  uint32_t state[8];
+  std::copy(std::begin(outer_), std::end(outer_), state);
+  Sha256::compress(state, block);
+  storeState(state, out);
+  secureWipe(block, sizeof(block));
+  secureWipe(state, sizeof(state));
+}
+
+void HmacSha256::mac(const uint8_t* key, size_t key_len, const uint8_t* data,
+                     size_t len, uint8_t* out) {
+  HmacSha256 h(key, key_len);
+  h.update(data, len);
+  h.final(out);
+}
+
+void HmacSha256::pbkdf2(ByteView salt, ByteView salt_suffix,
+                        uint32_t iterations, uint8_t* out, size_t out_len,
+                        const CancelToken* cancel) {
+  // U_1 = PRF(P, S || INT(i)), U_j = PRF(P, U_j-1), T_i = U_1 ^ ... ^ U_c
+  uint8_t block[Sha256::kBlockSize];
+  padDigestBlock(block);
+  for (uint32_t i = 1; out_len > 0; i++) {
+    uint8_t ctr[4];
+    storeBE(ctr, i);
+    init();
+    update(salt);
+    update(salt_suffix);
+    update(ctr, sizeof(ctr));
+    final(block);
+    uint32_t t[8];
+    for (int k = 0; k < 8; k++) t[k] = loadBE(block + 4 * k);
+
+    // U_j from U_j-1 is two compressions on fixed size padded blocks
+    for (uint32_t j = 1; j < iterations; j++) {
+      if (cancel != nullptr && j % CANCEL_INTERVAL == 0 &&
+          cancel->status() != CancelToken::Status::kActive) {
+        secureWipe(t, sizeof(t));
+        secureWipe(block, sizeof(block));
+        cancel->check();
+      }
+      uint32_t state[8];
+      std::copy(std::begin(inner_), std::end(inner_), state);
+      Sha256::compress(state, block);
+      storeState(state, block);
+      std::copy(std::begin(outer_), std::end(outer_), state);
+      Sha256::compress(state, block);
+      storeState(state, block);
+      for (int k = 0; k < 8; k++) t[k] ^= state[k];
+    }
+
+    uint8_t tb[Sha256::kSize];
+    storeState(t, tb);
+    size_t n = std::min(out_len, Sha256::kSize);
+    std::memcpy(out, tb, n);
+    out += n;
+    out_len -= n;
+    secureWipe(tb, sizeof(tb));
+    secureWipe(t, sizeof(t));
+  }
+  secureWipe(block, sizeof(block));
+}
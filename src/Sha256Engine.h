@@ -0,0 +1,101 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SHA256ENGINE_H
+#define SHA256ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ByteView.h"
+
+class CancelToken;
+
+///
+/// \brief SHA-256 hash, HMAC-SHA256 and PBKDF2-HMAC-SHA256.
+///
+/// Used by in-process WarpWallet key derivation. PBKDF2 reuses inner and
+/// outer HMAC states of password, one iteration costs two compressions.
+///
+class Sha256 {
+ public:
+  static const size_t kSize{32};
+  static const size_t kBlockSize{64};
+
+  Sha256() { init(); }
+
+  void init();
+  void update(const uint8_t* data, size_t len);
+  void update(ByteView data) { update(data.data(), data.size()); }
+  void final(uint8_t* out);
+
+  /// \brief Hash of data.
+  static void hash(const uint8_t* data, size_t len, uint8_t* out);
+
+ private:
+  friend class HmacSha256;
+  static void compress(uint32_t* state, const uint8_t* block);
+
+  uint32_t state_[8];
+  uint8_t buf_[kBlockSize];
+  size_t buf_len_;
+  uint64_t total_;
+};
+
+/// \brief HMAC-SHA256 with precomputed key pads.
+class HmacSha256 {
+ public:
+  HmacSha256(const uint8_t* key, size_t len)
+      : HmacSha256(ByteView(key, len)) {}
+
+  /// \brief MAC keyed by concatenation of key and suffix, suffix is streamed
+  /// into key block without copying key.
+  explicit HmacSha256(ByteView key, ByteView suffix = ByteView());
+  ~HmacSha256();
+
+  void init();
+  void update(const uint8_t* data, size_t len);
+  void update(ByteView data) { update(data.data(), data.size()); }
+  void final(uint8_t* out);
+
+  /// \brief MAC of data.
+  static void mac(const uint8_t* key, size_t key_len, const uint8_t* data,
+                  size_t len, uint8_t* out);
+
+  /// \brief PBKDF2 using this MAC as pseudo random function. Throws
+  /// OperationCancelled when 'cancel' fires, checked every 4096 iterations.
+  void pbkdf2(const uint8_t* salt, size_t salt_len, uint32_t iterations,
+              uint8_t* out, size_t out_len,
+              const CancelToken* cancel = nullptr) {
+    pbkdf2(ByteView(salt, salt_len), ByteView(), iterations, out, out_len,
+           cancel);
+  }
+
+  /// \brief PBKDF2 with concatenation of salt and suffix as salt.
+  void pbkdf2(ByteView salt, ByteView salt_suffix, uint32_t iterations,
+              uint8_t* out, size_t out_len,
+              const CancelToken* cancel = nullptr);
+
+ private:
+  uint32_t inner_[8];  /// state after key ^ ipad block
+  uint32_t outer_[8];  /// state after key ^ opad block
+  Sha256 ctx_;
+};
+
+#endif  // SHA256ENGINE_H
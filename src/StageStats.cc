@@ -0,0 +1,129 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "StageStats.h"
+
+std::atomic<bool> StageStats::enabled_(false);
+std::atomic<bool> StageStats::perf_enabled_(false);
+
+namespace {
+/// \brief Counters of one stage, updated by all threads.
+struct alignas(64) StageCounters {
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> calls_;
+  std::atomic<uint64_t> total_ns_;
+  std::atomic<uint64_t> max_ns_;
+  std::array<std::atomic<uint64_t>, STAGE_BUCKETS> histogram_;
+  std::atomic<uint64_t> perf_count_;
+  std::array<std::atomic<uint64_t>, PERF_EVENT_COUNT> events_;
+};
+
+StageCounters COUNTERS[STAGE_COUNT];
+
+const char* STAGE_NAMES[STAGE_COUNT] = {"scrypt", "pbkdf2", "ec", "encoding",
+                                        "serialization"};
+
+size_t bucket(uint64_t ns) {
+  uint64_t us = ns / 1000;
+  size_t k = 0;
+  while (us > 1 && k + 1 < STAGE_BUCKETS) {
+    us >>= 1;
+    k++;
+  }
+  return k;
+}
+}
+
+void StageStats::enable(bool on) { enabled_ = on; }
+
+bool StageStats::enablePerf(bool on) {
+  if (on) enabled_ = true;
+  perf_enabled_ = on && PerfCounters::probe();
+  return perf_enabled_;
+}
+
+void StageStats::record(Stage stage, uint64_t ns, uint64_t items,
+                        const uint64_t* events) {
+  StageCounters& c = COUNTERS[static_cast<int>(stage)];
+  c.count_.fetch_add(items, std::memory_order_relaxed);
+  c.calls_.fetch_add(1, std::memory_order_relaxed);
+  c.total_ns_.fetch_add(ns, std::memory_order_relaxed);
+  uint64_t m = c.max_ns_.load(std::memory_order_relaxed);
+  while (ns > m && !c.max_ns_.compare_exchange_weak(m, ns)) {
+  }
+  if (items > 0)
+    c.histogram_[bucket(ns / items)].fetch_add(items,
+                                               std::memory_order_relaxed);
+  if (events != nullptr) {
+    c.perf_count_.fetch_add(items, std::memory_order_relaxed);
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++)
+      c.events_[i].fetch_add(events[i], std::memory_order_relaxed);
+  }
+}
+
+void StageStats::reset() {
+  for (auto& c : COUNTERS) {
+    c.count_ = 0;
+    c.calls_ = 0;
+    c.total_ns_ = 0;
+    c.max_ns_ = 0;
+    for (auto& h : c.histogram_) h = 0;
+    c.perf_count_ = 0;
+    for (auto& e : c.events_) e = 0;
+  }
+}
+
+std::vector<StageSummary> StageStats::summary() {
+  std::vector<StageSummary> stages;
+  for (size_t i = 0; i < STAGE_COUNT; i++) {
+    const StageCounters& c = COUNTERS[i];
+    if (c.calls_ == 0) continue;
+    StageSummary s;
+    s.stage_ = static_cast<Stage>(i);
+    s.count_ = c.count_;
+    s.calls_ = c.calls_;
+    s.total_ns_ = c.total_ns_;
+    s.max_ns_ = c.max_ns_;
+    for (size_t k = 0; k < STAGE_BUCKETS; k++)
+      s.histogram_[k] = c.histogram_[k];
+    s.perf_count_ = c.perf_count_;
+    for (size_t k = 0; k < PERF_EVENT_COUNT; k++) s.events_[k] = c.events_[k];
+    stages.push_back(s);
+  }
+  return stages;
+}
+
+const char* StageStats::name(Stage stage) {
+  return STAGE_NAMES[static_cast<int>(stage)];
+}
+
+void StageTimer::stop() {
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start_)
+                    .count();
+  uint64_t events[PERF_EVENT_COUNT];
+  if (perf_ && PerfCounters::read(events)) {
+    // scaled counts of multiplexed events may step back
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++)
+      events[i] = (events[i] > events_[i] ? events[i] - events_[i] : 0);
+    StageStats::record(stage_, ns, items_, events);
+  } else {
+    StageStats::record(stage_, ns, items_);
+  }
+}
@@ -0,0 +1,129 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STAGESTATS_H
+#define STAGESTATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PerfCounters.h"
+
+/// \brief Instrumented stages of key generation.
+enum class Stage : int {
+  kScrypt = 0,     /// scrypt seed of WarpWallet key
+  kPbkdf2,         /// PBKDF2 seed of WarpWallet key
+  kEc,             /// secp256k1 multiplication and normalization
+  kEncoding,       /// address, WIF and hex encoding of key pair
+  kSerialization   /// key records and JSON documents
+};
+
+const size_t STAGE_COUNT{5};
+
+/// histogram buckets, bucket k counts durations of [2^k, 2^(k+1)) us and
+/// bucket 0 also shorter ones
+const size_t STAGE_BUCKETS{32};
+
+/// \brief Aggregated durations of one stage.
+struct StageSummary {
+  Stage stage_;
+  uint64_t count_;     /// items, e.g. keys
+  uint64_t calls_;     /// timed calls, one call may cover many items
+  uint64_t total_ns_;
+  uint64_t max_ns_;    /// longest call
+  std::array<uint64_t, STAGE_BUCKETS> histogram_;  /// per item duration
+  uint64_t perf_count_;  /// items of calls with hardware counters
+  std::array<uint64_t, PERF_EVENT_COUNT> events_;  /// hardware event totals
+};
+
+///
+/// \brief Process wide per-stage timing, opt-in by option --stats.
+///
+/// Disabled timers cost one relaxed atomic load. Enabled timers read
+/// steady_clock twice and update counters of their stage with relaxed
+/// atomics, stages are kept on cache lines of their own. With option
+/// --perf-counters timers also read hardware counters of their thread.
+///
+class StageStats {
+ public:
+  static void enable(bool on);
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /// \brief Enables stats and hardware counters, returns false if no
+  /// counter could be opened, stats are then kept without them.
+  static bool enablePerf(bool on);
+  static bool perfEnabled() {
+    return perf_enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// \brief Adds call of 'ns' nanoseconds covering 'items' items,
+  /// 'events' are hardware event counts of call or null.
+  static void record(Stage stage, uint64_t ns, uint64_t items = 1,
+                     const uint64_t* events = nullptr);
+
+  /// \brief Clears counters of all stages.
+  static void reset();
+
+  /// \brief Stages timed so far, in stage order.
+  static std::vector<StageSummary> summary();
+
+  static const char* name(Stage stage);
+
+ private:
+  static std::atomic<bool> enabled_;
+  static std::atomic<bool> perf_enabled_;
+};
+
+///
+/// \brief Times scope as one call of stage when stats are enabled.
+///
+class StageTimer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit StageTimer(Stage stage, uint64_t items = 1)
+      : stage_(stage), items_(items), on_(StageStats::enabled()),
+        perf_(false) {
+    if (!on_) return;
+    if (StageStats::perfEnabled()) perf_ = PerfCounters::read(events_);
+    start_ = Clock::now();
+  }
+  ~StageTimer() {
+    if (on_) stop();
+  }
+
+  StageTimer(const StageTimer&) = delete;
+  StageTimer& operator=(const StageTimer&) = delete;
+
+ private:
+  void stop();
+
+  Stage stage_;
+  uint64_t items_;
+  bool on_;
+  bool perf_;
+  Clock::time_point start_;
+  uint64_t events_[PERF_EVENT_COUNT];  /// counters at start
+};
+
+#endif  // STAGESTATS_H
@@ -0,0 +1,309 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+#include "CoinEncoding.h"
+#include "HDWallet.h"
+#include "Secp256k1.h"
+#include "SecureMemory.h"
+#include "Sha256Engine.h"
+#include "TestVectors.h"
+#include "WarpKeyGenerator.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+extern std::string byte2HexString(const uint8_t* data, int len);
+
+namespace {
+const std::string SPEC_SUFFIX{".spec.json"};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+bool isDirectory(const std::string& path) {
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/// \brief Spec files of directory in name order.
+std::vector<std::string> specFiles(const std::string& dir) {
+  std::vector<std::string> files;
+  DIR* d = ::opendir(dir.c_str());
+  if (d == nullptr)
+    throw std::invalid_argument("TestVectors::cannot open directory " + dir);
+  while (struct dirent* e = ::readdir(d)) {
+    std::string name(e->d_name);
+    if (name.size() > SPEC_SUFFIX.size() &&
+        name.compare(name.size() - SPEC_SUFFIX.size(), SPEC_SUFFIX.size(),
+                     SPEC_SUFFIX) == 0)
+      files.push_back(dir + "/" + name);
+  }
+  ::closedir(d);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+/// \brief JSON document of file, text in front of it is skipped.
+json readSpec(const std::string& path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::invalid_argument("TestVectors::cannot open file " + path);
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  size_t begin = text.find('{');
+  if (begin == std::string::npos)
+    throw std::invalid_argument("TestVectors::no JSON document in " + path);
+  try {
+    return json::parse(text.substr(begin));
+  } catch (std::exception& e) {
+    throw std::invalid_argument("TestVectors::invalid JSON in " + path);
+  }
+}
+
+Password toPassword(const std::string& s) {
+  return Password(s.begin(), s.end());
+}
+
+std::string toString(const ByteVect& v) {
+  return std::string(v.begin(), v.end());
+}
+
+std::string member(const json& j, const char* name) {
+  auto it = j.find(name);
+  return (it != j.end() && it->is_string() ? it->get<std::string>() : "");
+}
+
+/// \brief Copies expected key pair of command output record.
+void expectKey(const json& record, TestVector& v) {
+  auto it = record.find("key");
+  if (it == record.end()) return;
+  v.address_ = member(*it, "address");
+  v.wif_ = member(*it, "privateKeyWif");
+  v.pub_hex_ = member(*it, "publicKeyHex");
+}
+
+/// \brief Vectors of WarpWallet spec, seeds are scrypt, PBKDF2 and key.
+void loadWarpSpec(const json& spec, const std::string& name,
+                  std::vector<TestVector>& out) {
+  const json& vectors = spec["vectors"];
+  for (size_t i = 0; i < vectors.size(); i++) {
+    const json& e = vectors[i];
+    TestVector v;
+    v.spec_ = name;
+    v.index_ = i;
+    v.cid_ = CoinId::kBitCoin;
+    v.pwd_ = toPassword(member(e, "passphrase"));
+    v.salt_ = toPassword(member(e, "salt"));
+    auto seeds = e.find("seeds");
+    if (seeds != e.end() && seeds->size() == 3) {
+      v.scrypt_ = (*seeds)[0].get<std::string>();
+      v.pbkdf2_ = (*seeds)[1].get<std::string>();
+      v.key_ = (*seeds)[2].get<std::string>();
+    }
+    auto keys = e.find("keys");
+    if (keys != e.end()) {
+      v.wif_ = member(*keys, "private");
+      v.address_ = member(*keys, "public");
+    }
+    out.push_back(v);
+  }
+}
+
+/// \brief Vectors of saved command output.
+void loadCommandSpec(const json& spec, const std::string& name,
+                     std::vector<TestVector>& out) {
+  const json& user = spec["_user"];
+  const std::string command = member(user, "command");
+  TestVector base;
+  base.spec_ = name;
+  base.cid_ = CoinId(user.value("network", 1));
+  base.salt_ = toPassword(member(user, "salt"));
+  size_t index{0};
+
+  if (command == "generate-key") {
+    TestVector v(base);
+    v.index_ = index++;
+    v.pwd_ = toPassword(member(user, "password"));
+    expectKey(spec, v);
+    out.push_back(v);
+  } else if (command == "generate-key-random") {
+    for (const json& record : spec["keys"]) {
+      TestVector v(base);
+      v.index_ = index++;
+      v.pwd_ = toPassword(member(record, "_password"));
+      expectKey(record, v);
+      out.push_back(v);
+    }
+  } else if (command == "generate-wallet-deterministic-simple") {
+    // root key and each child are checked on their own, child password is
+    // root hex followed by child index, v2 child is HMAC of root and index
+    const json& wallet = user["wallet"];
+    const std::string root = member(wallet, "keyRoot");
+    const std::string type = member(wallet, "_type");
+    if (type != "deterministic-simple" && type != "deterministic-simple-v2")
+      throw std::invalid_argument("TestVectors::unsupported wallet " + type +
+                                  " in " + name);
+    bool v2 = (type == "deterministic-simple-v2");
+    unsigned long long magic = wallet.value("magic", 0ULL);
+    if (!member(user, "password").empty()) {
+      TestVector v(base);
+      v.index_ = index++;
+      v.pwd_ = toPassword(member(user, "password"));
+      v.key_ = root;
+      out.push_back(v);
+    }
+    // children of key range start at offset "keyFrom"
+    unsigned long long child = magic + wallet.value("keyFrom", 0ULL);
+    for (const json& record : spec["keys"]) {
+      TestVector v(base);
+      v.index_ = index++;
+      if (v2) {
+        v.dts_root_ = root;
+        v.dts_child_ = child++;
+      } else {
+        v.pwd_ = toPassword(root + std::to_string(child++));
+      }
+      expectKey(record, v);
+      out.push_back(v);
+    }
+  } else {
+    throw std::invalid_argument("TestVectors::unsupported command " +
+                                command + " in " + name);
+  }
+}
+
+/// \brief Compares hex or base58 values, hex case is ignored.
+TestCheck check(const std::string& expected, const std::string& actual,
+                bool hex) {
+  if (expected.empty()) return TestCheck::kSkipped;
+  if (!hex)
+    return (expected == actual ? TestCheck::kPassed : TestCheck::kFailed);
+  auto lower = [](unsigned char a, unsigned char b) {
+    return std::tolower(a) == std::tolower(b);
+  };
+  bool same = (expected.size() == actual.size() &&
+               std::equal(expected.begin(), expected.end(), actual.begin(),
+                          lower));
+  return (same ? TestCheck::kPassed : TestCheck::kFailed);
+}
+
+void throwIfStopped(int status) {
+  if (status == WarpKeyGenerator::kCancelled)
+    throw OperationCancelled(CancelToken::Status::kCancelled);
+  if (status == WarpKeyGenerator::kTimeout)
+    throw OperationCancelled(CancelToken::Status::kTimeout);
+}
+}
+
+bool TestResult::passed() const {
+  const TestCheck checks[] = {scrypt_, pbkdf2_, key_, address_, wif_, pub_hex_};
+  return error_.empty() &&
+         std::none_of(std::begin(checks), std::end(checks),
+                      [](TestCheck c) { return c == TestCheck::kFailed; });
+}
+
+std::vector<TestVector> loadTestVectors(const std::vector<std::string>& paths) {
+  std::vector<std::string> files;
+  for (const std::string& path : paths) {
+    if (isDirectory(path)) {
+      std::vector<std::string> dir = specFiles(path);
+      files.insert(files.end(), dir.begin(), dir.end());
+    } else {
+      files.push_back(path);
+    }
+  }
+
+  std::vector<TestVector> vectors;
+  for (const std::string& file : files) {
+    json spec = readSpec(file);
+    std::string name = file.substr(file.find_last_of('/') + 1);
+    if (spec.find("vectors") != spec.end())
+      loadWarpSpec(spec, name, vectors);
+    else if (spec.find("_user") != spec.end())
+      loadCommandSpec(spec, name, vectors);
+    else
+      throw std::invalid_argument("TestVectors::unknown format of " + file);
+  }
+  return vectors;
+}
+
+TestResult runTestVector(const TestVector& vector, const CancelToken* cancel) {
+  TestResult r;
+  Clock::time_point start = Clock::now();
+  WarpKeyGenerator gen;
+  SecretKey s1, s2, key;
+  bool compressed = !vector.dts_root_.empty();
+
+  if (compressed) {
+    // DTS v2 child, no KDF
+    ByteVect root;
+    if (!hexDecode(reinterpret_cast<const uint8_t*>(vector.dts_root_.data()),
+                   vector.dts_root_.size(), root) ||
+        root.size() != 32)
+      throw std::invalid_argument("TestVectors::invalid wallet root key");
+    HmacSha256 mac(root.data(), root.size());
+    secureWipe(root.data(), root.size());
+    if (!dtsChildSecret(mac, vector.dts_child_, key.data()))
+      throw std::domain_error("TestVectors::invalid secret key");
+  } else {
+    throwIfStopped(gen.scryptSeed(vector.pwd_, vector.salt_, s1, cancel));
+    r.scrypt_ms_ = elapsedMs(start);
+    Clock::time_point t0 = Clock::now();
+    throwIfStopped(gen.pbkdf2Seed(vector.pwd_, vector.salt_, s2, cancel));
+    r.pbkdf2_ms_ = elapsedMs(t0);
+    std::transform(s1.begin(), s1.end(), s2.begin(), key.begin(),
+                   std::bit_xor<uint8_t>());
+
+    r.scrypt_ =
+        check(vector.scrypt_, byte2HexString(s1.data(), s1.size()), true);
+    r.pbkdf2_ =
+        check(vector.pbkdf2_, byte2HexString(s2.data(), s2.size()), true);
+    r.key_ = check(vector.key_, byte2HexString(key.data(), key.size()), true);
+  }
+
+  if (!vector.address_.empty() || !vector.wif_.empty() ||
+      !vector.pub_hex_.empty()) {
+    uint8_t pub[65];
+    size_t len = Secp256k1::publicKey(key.data(), compressed, pub);
+    if (len == 0) throw std::domain_error("TestVectors::invalid secret key");
+    CoinKeyPair coin = encodeKeyPair(vector.cid_, pub, len, key.data());
+    r.address_ = check(vector.address_, toString(coin.address()), false);
+    r.wif_ = check(vector.wif_, toString(coin.privateKey()), false);
+    r.pub_hex_ = check(vector.pub_hex_, toString(coin.publicKey()), true);
+  }
+  secureWipe(s1.data(), s1.size());
+  secureWipe(s2.data(), s2.size());
+  secureWipe(key.data(), key.size());
+  r.ms_ = elapsedMs(start);
+  return r;
+}
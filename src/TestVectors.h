@@ -0,0 +1,94 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TESTVECTORS_H
+#define TESTVECTORS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CancelToken.h"
+#include "CoinKeyPair.h"
+#include "RandomSeedGenerator.h"
+
+///
+/// \brief Expected results of one key derivation of a spec file.
+///
+/// Values that a spec file does not give are empty and not checked. Hex
+/// values are compared case insensitively. Key is derived from passphrase
+/// and salt with uncompressed public key, or for DTS v2 child from its root
+/// key with compressed public key.
+///
+struct TestVector {
+  std::string spec_;              /// spec file name
+  size_t index_{0};               /// position in spec file
+  CoinId cid_{CoinId::kBitCoin};  /// network of addresses and WIFs
+  Password pwd_;                  /// passphrase
+  Password salt_;                 /// salt
+  std::string scrypt_;            /// hex of scrypt seed
+  std::string pbkdf2_;            /// hex of PBKDF2 seed
+  std::string key_;               /// hex of key, XOR of the seeds
+  std::string address_;           /// address of public key
+  std::string wif_;               /// private key WIF
+  std::string pub_hex_;           /// hex of public key
+  std::string dts_root_;  /// hex of root key of DTS v2 child, empty = none
+  uint64_t dts_child_{0};  /// index of DTS v2 child
+};
+
+/// \brief Outcome of one check of a test vector.
+enum class TestCheck { kSkipped = 0, kPassed, kFailed };
+
+/// \brief Per stage outcome and timing of a test vector.
+struct TestResult {
+  TestCheck scrypt_{TestCheck::kSkipped};
+  TestCheck pbkdf2_{TestCheck::kSkipped};
+  TestCheck key_{TestCheck::kSkipped};
+  TestCheck address_{TestCheck::kSkipped};
+  TestCheck wif_{TestCheck::kSkipped};
+  TestCheck pub_hex_{TestCheck::kSkipped};
+  double scrypt_ms_{0};
+  double pbkdf2_ms_{0};
+  double ms_{0};
+  std::string error_;  /// set when vector could not be run
+
+  /// \brief True when no check failed and vector was run.
+  bool passed() const;
+};
+
+///
+/// \brief Loads test vectors of spec files.
+///
+/// Paths are spec files or directories, of which all *.spec.json files are
+/// loaded in name order. Known formats are the WarpWallet spec with
+/// "vectors" and their seeds, and saved JSON output of commands
+/// generate-key, generate-key-random and generate-wallet-deterministic-simple
+/// (versions 1 and 2, also key ranges).
+/// Text before the JSON document is skipped. Throws std::invalid_argument
+/// when a file cannot be read or has unknown format.
+///
+std::vector<TestVector> loadTestVectors(const std::vector<std::string>& paths);
+
+/// \brief Derives key of vector and checks each stage, throws
+/// OperationCancelled when 'cancel' fires.
+TestResult runTestVector(const TestVector& vector,
+                         const CancelToken* cancel = nullptr);
+
+#endif  // TESTVECTORS_H
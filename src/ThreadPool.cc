@@ -0,0 +1,240 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <iterator>
+
+#include "ThreadPool.h"
+
+namespace {
+/// pool and queue index of the current worker thread
+thread_local const ThreadPool* WORKER_POOL{nullptr};
+thread_local size_t WORKER_IDX{0};
+
+/// completion latch shared by the tasks of one parallelFor() call
+struct Latch {
+  std::mutex mutex_;
+  std::condition_variable done_;
+  size_t count_;
+  std::exception_ptr error_;
+};
+
+/// completion flags of the in-flight window of one orderedFor() call
+struct Window {
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::vector<bool> ready_;
+  size_t running_;
+  std::exception_ptr error_;
+};
+}
+
+ThreadPool::ThreadPool(size_t threads) : pending_(0), next_(0), stop_(false) {
+  if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < threads; i++)
+    queues_.emplace_back(std::make_unique<Queue>());
+  for (size_t i = 0; i < threads; i++)
+    threads_.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& t : threads_) t.join();
+}
+
+bool ThreadPool::isWorker() const { return WORKER_POOL == this; }
+
+void ThreadPool::submit(Task task, const void* group) {
+  size_t idx = isWorker() ? WORKER_IDX : next_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    ++pending_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues_[idx]->mutex_);
+    queues_[idx]->tasks_.push_back(Entry{std::move(task), group});
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::pop(size_t idx, const void* group, Task& task) {
+  Queue& q = *queues_[idx];
+  std::lock_guard<std::mutex> lock(q.mutex_);
+  for (auto it = q.tasks_.rbegin(); it != q.tasks_.rend(); ++it) {
+    if (group != nullptr && it->group_ != group) continue;
+    task = std::move(it->task_);
+    q.tasks_.erase(std::next(it).base());
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::steal(size_t idx, const void* group, Task& task) {
+  for (size_t i = 1; i < queues_.size(); i++) {
+    Queue& q = *queues_[(idx + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(q.mutex_);
+    for (auto it = q.tasks_.begin(); it != q.tasks_.end(); ++it) {
+      if (group != nullptr && it->group_ != group) continue;
+      task = std::move(it->task_);
+      q.tasks_.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::runPending(const void* group) {
+  if (group == nullptr) return false;
+  size_t idx = isWorker() ? WORKER_IDX : 0;
+  Task task;
+  if (!pop(idx, group, task) && !steal(idx, group, task)) return false;
+  --pending_;
+  task();
+  return true;
+}
+
+void ThreadPool::run(size_t idx) {
+  WORKER_POOL = this;
+  WORKER_IDX = idx;
+  for (;;) {
+    Task task;
+    if (pop(idx, nullptr, task) || steal(idx, nullptr, task)) {
+      --pending_;
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_.wait(lock, [this] { return stop_ || pending_ > 0; });
+    if (stop_ && pending_ == 0) return;
+  }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end,
+                             const std::function<void(size_t)>& f) {
+  if (begin >= end) return;
+  auto latch = std::make_shared<Latch>();
+  latch->count_ = end - begin;
+  for (size_t i = begin; i < end; i++) {
+    submit(
+        [latch, &f, i] {
+          try {
+            f(i);
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(latch->mutex_);
+            if (!latch->error_) latch->error_ = std::current_exception();
+          }
+          std::lock_guard<std::mutex> lock(latch->mutex_);
+          if (--latch->count_ == 0) latch->done_.notify_all();
+        },
+        latch.get());
+  }
+
+  // worker threads help with tasks of this call instead of blocking, others
+  // just wait so that the number of concurrent derivations stays bounded by
+  // pool size
+  if (isWorker()) {
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(latch->mutex_);
+        if (latch->count_ == 0) break;
+      }
+      if (!runPending(latch.get())) std::this_thread::yield();
+    }
+  } else {
+    std::unique_lock<std::mutex> lock(latch->mutex_);
+    latch->done_.wait(lock, [&latch] { return latch->count_ == 0; });
+  }
+  if (latch->error_) std::rethrow_exception(latch->error_);
+}
+
+void ThreadPool::orderedFor(size_t begin, size_t end, size_t window,
+                            const std::function<void(size_t, size_t)>& work,
+                            const std::function<void(size_t, size_t)>& emit) {
+  if (begin >= end) return;
+  if (window == 0) window = 1;
+  auto w = std::make_shared<Window>();
+  w->ready_.assign(window, false);
+  w->running_ = 0;
+
+  auto start = [this, w, &work, window](size_t i) {
+    w->running_++;
+    submit(
+        [w, &work, window, i] {
+          size_t slot = i % window;
+          try {
+            work(i, slot);
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(w->mutex_);
+            if (!w->error_) w->error_ = std::current_exception();
+          }
+          std::lock_guard<std::mutex> lock(w->mutex_);
+          w->ready_[slot] = true;
+          w->running_--;
+          w->done_.notify_all();
+        },
+        w.get());
+  };
+
+  size_t next = begin;
+  {
+    std::lock_guard<std::mutex> lock(w->mutex_);
+    while (next < end && next - begin < window) start(next++);
+  }
+  // same waiting policy as in parallelFor(), workers help
+  auto wait = [this, &w](const std::function<bool()>& pred) {
+    std::unique_lock<std::mutex> lock(w->mutex_);
+    if (!isWorker()) {
+      w->done_.wait(lock, pred);
+      return;
+    }
+    while (!pred()) {
+      lock.unlock();
+      if (!runPending(w.get())) std::this_thread::yield();
+      lock.lock();
+    }
+  };
+
+  for (size_t i = begin; i < end; i++) {
+    size_t slot = i % window;
+    wait([&w, slot] { return w->ready_[slot] || w->error_; });
+    {
+      std::lock_guard<std::mutex> lock(w->mutex_);
+      if (w->error_) break;
+      w->ready_[slot] = false;
+    }
+    try {
+      emit(i, slot);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(w->mutex_);
+      w->error_ = std::current_exception();
+      break;
+    }
+    std::lock_guard<std::mutex> lock(w->mutex_);
+    if (next < end) start(next++);
+  }
+
+  // let tasks still running finish before caller storage goes away
+  wait([&w] { return w->running_ == 0; });
+  if (w->error_) std::rethrow_exception(w->error_);
+}
@@ -0,0 +1,114 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \class ThreadPool
+/// \brief Work-stealing thread pool for running key derivations in parallel.
+///
+/// Every worker owns a task deque. A worker pops its own tasks LIFO and when
+/// idle steals FIFO from the other workers. Tasks submitted from outside the
+/// pool are distributed round-robin. A worker waiting for tasks of a group,
+/// e.g. of one parallelFor() call, runs only tasks of that group, so an
+/// unrelated long task never runs nested inside the wait. Work that must
+/// start in arrival order is kept in a queue of its own and every submitted
+/// task takes the oldest item from it.
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  /// \brief Starts given number of workers, 0 = hardware concurrency.
+  explicit ThreadPool(size_t threads = 0);
+  virtual ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// \brief Number of worker threads.
+  size_t size() const { return queues_.size(); }
+
+  /// \brief Queues task for execution, 'group' identifies tasks a waiting
+  /// worker may run, see runPending().
+  void submit(Task task, const void* group = nullptr);
+
+  /// \brief Runs f(i) for each i in [begin, end) and waits for completion.
+  ///
+  /// The first exception thrown by f is rethrown to the caller after all
+  /// started tasks have finished. When called from a worker thread the
+  /// caller keeps executing queued tasks of this call while waiting, so
+  /// nested calls do not deadlock.
+  void parallelFor(size_t begin, size_t end,
+                   const std::function<void(size_t)>& f);
+
+  /// \brief Runs work(i, slot) for each i in [begin, end) with at most
+  /// 'window' items in flight and calls emit(i, slot) in index order.
+  ///
+  /// Slot is in range [0, window) and identifies caller owned storage for
+  /// the item, it is reused after emit() returns. Emit is always called from
+  /// the calling thread.
+  void orderedFor(size_t begin, size_t end, size_t window,
+                  const std::function<void(size_t, size_t)>& work,
+                  const std::function<void(size_t, size_t)>& emit);
+
+  /// \brief Executes one queued task of 'group' in the calling thread, if
+  /// any. Tasks of other groups are left to idle workers.
+  bool runPending(const void* group);
+
+  /// \brief True when called from one of the pool's worker threads.
+  bool isWorker() const;
+
+ private:
+  struct Entry {
+    Task task_;
+    const void* group_;
+  };
+
+  struct Queue {
+    std::mutex mutex_;
+    std::deque<Entry> tasks_;
+  };
+
+  /// pop and steal take task of 'group', any task when group is null
+  void run(size_t idx);
+  bool pop(size_t idx, const void* group, Task& task);
+  bool steal(size_t idx, const void* group, Task& task);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<size_t> pending_;
+  std::atomic<size_t> next_;
+  bool stop_;
+};
+
+#endif  // THREADPOOL_H
@@ -18,10 +18,13 @@
 ** along with this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <chrono>
 
 #include "CLI.hpp"
+#include "MachineProfile.h"
 #include "UserInterface.h"
+#include "WarpKeyGenerator.h"
 
 using namespace CLI;
 
@@ -47,7 +50,12 @@ enum CommandEnum : std::uint32_t {
   AttachAddress = 3,
   GenerateWalletSD = 4,
   GenerateWalletBIP32 = 5,
-  Test = 6
+  Test = 6,
+  GenerateAddressesXpub = 7,
+  BatchJobs = 8,
+  ServeJobs = 9,
+  BenchThroughput = 10,
+  TuneEngine = 11
 };
 }
 
@@ -57,20 +65,83 @@ UserInterface::UserInterface(std::ostream& out)
       oper_(OPER_DEFAULT),
       pwd_(DEFAULT_PWD),
       salt_(DEFAULT_SALT),
+      threads_(0),
+      interleave_(1),
+      huge_pages_("default"),
+      format_(OutputFormat::kJson),
+      progress_(false),
+      stats_(false),
+      perf_counters_(false),
+      deadline_ms_(0),
       out_(out) {}
 
 void UserInterface::reset() {
   pwd_ = DEFAULT_PWD;
   salt_ = DEFAULT_SALT;
   oper_ = OPER_DEFAULT;
+  format_ = OutputFormat::kJson;
+  output_.clear();
+  progress_ = false;
+  stats_ = false;
+  perf_counters_ = false;
+  root_cache_.clear();
+  deadline_ms_ = 0;
+  test_specs_.clear();
+  bench_ = std::experimental::nullopt;
+  scrypt_kernel_.clear();
+  tuned_ = std::experimental::nullopt;
 }
 
 void UserInterface::show(const std::ostringstream& result) {
   out_ << result.str();
 }
 
-/// \todo parse() method way too long, refactor it
 bool UserInterface::parse(int argc, char** argv) {
+  return parseArgs(argc, argv, nullptr, nullptr);
+}
+
+bool UserInterface::parseJob(
+    const std::string& network, const std::string& command,
+    const UserArguments& options, const UserArguments& params,
+    const std::experimental::optional<MachineProfile>& tuned) {
+  // job selects wallet parameters only, output, engine and cache settings
+  // belong to batch or daemon process
+  static const UserArguments allowed{"--dts-version", "--from", "--count",
+                                     "--stats", "--perf-counters"};
+  for (auto& o : options) {
+    if (o.empty() || o[0] != '-') continue;
+    std::string name = o.substr(0, o.find('='));
+    if (std::find(allowed.begin(), allowed.end(), name) == allowed.end())
+      throw std::invalid_argument("batch: job option " + name +
+                                  " not allowed");
+  }
+  UserArguments args{"batch", "-n", network, "-c", command};
+  args.insert(args.end(), options.begin(), options.end());
+  std::vector<char*> argv;
+  for (auto& a : args) argv.push_back(&a[0]);
+  if (!parseArgs(static_cast<int>(argv.size()), argv.data(), &params, &tuned))
+    return false;
+
+  // job result is one JSON document held in memory until job is done
+  uint64_t keys{0};
+  if (oper_ == OPER_GENERATE_COIN_RANDOM && random_)
+    keys = random_.value().keys_;
+  else if (oper_ == OPER__GENERATE_WALLET_DTS && dts_wallet_)
+    keys = dts_wallet_.value().keys_;
+  else if (oper_ == OPER__GENERATE_WALLET_HD && hd_wallet)
+    keys = uint64_t(hd_wallet.value().external_keys_) +
+           hd_wallet.value().internal_keys_;
+  else if (oper_ == OPER_GENERATE_ADDRESSES_XPUB && xpub_watch_)
+    keys = xpub_watch_.value().keys_;
+  if (keys > MAX_KEYS_JSON)
+    throw std::out_of_range("batch: job key count > 999");
+  return true;
+}
+
+/// \todo parse() method way too long, refactor it
+bool UserInterface::parseArgs(
+    int argc, char** argv, const UserArguments* job_params,
+    const std::experimental::optional<MachineProfile>* tuned) {
   if (argc <= 1) return true;
   reset();
 
@@ -81,7 +152,7 @@ bool UserInterface::parse(int argc, char** argv) {
   CLI::App app("WarpWallet Utility Tool");
 
   // init network option
-  CoinEnum coin;
+  CoinEnum coin{BitCoin};
   CLI::Option* opt_coin = app.add_set(
       "-n,--network", coin, {BitCoin, BitCoinTest, LiteCoin, LiteCoinTest});
   opt_coin->set_type_name(
@@ -93,10 +164,12 @@ bool UserInterface::parse(int argc, char** argv) {
   opt_coin->set_default_val(" 1");
 
   // init command option
-  CommandEnum cmd;
+  CommandEnum cmd{GenerateKeys};
   CLI::Option* opt_cmd = app.add_set(
       "-c,--command", cmd, {GenerateKeys, GenerateKeysRandom, AttachAddress,
-                            GenerateWalletSD, GenerateWalletBIP32, Test});
+                            GenerateWalletSD, GenerateWalletBIP32, Test,
+                            GenerateAddressesXpub, BatchJobs, ServeJobs,
+                            BenchThroughput, TuneEngine});
   opt_cmd->set_type_name(
       " enum/command in\n"
       "\t{GenerateKeys = 1,\n"
@@ -104,12 +177,17 @@ bool UserInterface::parse(int argc, char** argv) {
       "\t Attach = 3,\n"
       "\t GenerateWalletSD = 4,\n"
       "\t GenerateWalletBIP32 = 5,\n"
-      "\t Test = 6} ");
+      "\t Test = 6,\n"
+      "\t GenerateAddressesXpub = 7,\n"
+      "\t BatchJobs = 8,\n"
+      "\t ServeJobs = 9,\n"
+      "\t BenchThroughput = 10,\n"
+      "\t TuneEngine = 11} ");
   opt_cmd->set_default_val("1");
 
   // init command parameters option
-  std::vector<std::string> params{"password", "let@me.in"};
-  CLI::Option* opt_params = app.add_option("-p,--params", params);
+  std::vector<std::string> cli_params{"password", "let@me.in"};
+  CLI::Option* opt_params = app.add_option("-p,--params", cli_params);
   opt_params->set_type_name(
       "command parameters:\n"
       "\t1 = {password salt}\n"
@@ -118,13 +196,157 @@ bool UserInterface::parse(int argc, char** argv) {
       "\t4 = {password salt magic-number key-count is-watch-only}\n"
       "\t5 = {password salt external-key-count internal-key-count "
       "is-watch-only}\n"
-      "\t6 = {test-number test-vector-file-name} ");
+      "\t6 = {[spec-file | spec-directory ...]}\n"
+      "\t7 = {extended-public-key chain first-index key-count}\n"
+      "\t8 = {jobs-file | -}\n"
+      "\t9 = {socket-path}\n"
+      "\t10 = {key-count [random | dts ...]}\n"
+      "\t11 = {} ");
   opt_params->set_default_val(" 'Make Warp Great Again' let@me.in");
 
+  // init worker threads option
+  unsigned int threads{0};
+  CLI::Option* opt_threads = app.add_option(
+      "-t,--threads", threads,
+      "worker threads for bulk commands, limited by available memory");
+  opt_threads->set_default_val("0 (all cores)");
+
+  // init scrypt interleave option
+  unsigned int interleave{1};
+  CLI::Option* opt_interleave = app.add_set(
+      "--interleave", interleave, {1, 2, 3, 4},
+      "keys derived by one worker task with interleaved scrypt, hides "
+      "memory latency at the cost of scrypt memory per worker");
+  opt_interleave->set_default_val("1");
+
+  // init huge pages option
+  std::string huge_pages{"default"};
+  CLI::Option* opt_huge_pages = app.add_set(
+      "--huge-pages", huge_pages, {"default", "on", "off"},
+      "transparent huge pages of scrypt memory, default = system policy");
+  opt_huge_pages->set_default_val("default");
+
+  // init scrypt kernel option
+  std::string kernel;
+  std::string kernel_names;
+  for (auto& k : WarpKeyGenerator::kernels()) kernel_names += ' ' + k;
+  CLI::Option* opt_kernel = app.add_option(
+      "--scrypt-kernel", kernel, "scrypt kernel, one of" + kernel_names);
+  opt_kernel->set_default_val(WarpKeyGenerator::kernel());
+
+  // init machine profile option
+  std::string profile{MachineProfile::defaultPath()};
+  CLI::Option* opt_profile = app.add_option(
+      "--profile", profile,
+      "machine profile written by tune command, settings of bulk commands "
+      "and daemon not given on command line are read from it, none = not "
+      "used");
+  opt_profile->set_default_val(profile.empty() ? "none" : profile);
+
+  // init output format option
+  std::string format{"json"};
+  CLI::Option* opt_format = app.add_set(
+      "-f,--format", format, {"json", "ndjson", "csv", "binary"},
+      "output format, ndjson and csv stream key records as they are "
+      "generated, binary writes fixed size records into output file");
+  opt_format->set_default_val("json");
+
+  // init output file option
+  std::string output;
+  app.add_option("-o,--output", output,
+                 "output file name of binary format");
+
+  // init progress option
+  bool progress{false};
+  app.add_flag("--progress", progress,
+               "report progress, throughput and ETA of bulk commands to "
+               "stderr");
+
+  // init stage timing option
+  bool stats{false};
+  app.add_flag("--stats",
+               stats,
+               "add time spent in scrypt, PBKDF2, EC multiplication, encoding "
+               "and serialization to command result");
+
+  // init hardware counter option
+  bool perf_counters{false};
+  app.add_flag("--perf-counters",
+               perf_counters,
+               "add per key cycles, instructions, LLC and dTLB misses and "
+               "stalled cycles of each stage to stats, implies --stats");
+
+  // init deterministic wallet version option
+  unsigned int dts_version{1};
+  CLI::Option* opt_dts_version = app.add_set(
+      "--dts-version", dts_version, {1, 2},
+      "simple deterministic wallet version, 1 = child keys by WarpWallet "
+      "algorithm, 2 = child keys by HMAC-SHA256 of root key");
+  opt_dts_version->set_default_val("1");
+
+  // init deterministic wallet key range options
+  unsigned int from{0};
+  app.add_option("--from", from,
+                 "offset of first child key of simple deterministic wallet");
+  unsigned int count{0};
+  CLI::Option* opt_count =
+      app.add_option("--count", count,
+                     "child key count of simple deterministic wallet, "
+                     "overrides key count parameter");
+
+  // init root key cache option
+  std::string root_cache;
+  app.add_option("--root-cache", root_cache,
+                 "file caching wallet root keys encrypted by passphrase");
+
+  // init batch result order option
+  std::string batch_order{"input"};
+  CLI::Option* opt_batch_order = app.add_set(
+      "--batch-order", batch_order, {"input", "completion"},
+      "order of batch job results, input = same as jobs, completion = as "
+      "soon as job is done");
+  opt_batch_order->set_default_val("input");
+
+  // init job deadline option
+  unsigned int deadline{0};
+  CLI::Option* opt_deadline =
+      app.add_option("--deadline", deadline,
+                     "default deadline of batch and daemon jobs in "
+                     "milliseconds from reading the job, a job not completed "
+                     "in time is cancelled, also during key derivation, "
+                     "and fails with error timeout");
+  opt_deadline->set_default_val("0 (none)");
+
+  // init daemon queue option
+  unsigned int max_queue{64};
+  CLI::Option* opt_max_queue = app.add_option(
+      "--max-queue", max_queue,
+      "jobs queued or running in daemon, further jobs are rejected");
+  opt_max_queue->set_default_val("64");
+
+  // init benchmark sweep options
+  std::vector<unsigned int> sweep_threads;
+  CLI::Option* opt_sweep_threads = app.add_option(
+      "--sweep-threads", sweep_threads, "benchmark thread counts");
+  opt_sweep_threads->set_default_val("1 2 4 .. cores");
+  std::vector<unsigned int> sweep_interleave{1, 2};
+  CLI::Option* opt_sweep_interleave = app.add_option(
+      "--sweep-interleave", sweep_interleave, "benchmark interleave widths");
+  opt_sweep_interleave->set_default_val("1 2");
+  std::vector<std::string> sweep_huge_pages{"off", "on"};
+  CLI::Option* opt_sweep_huge_pages =
+      app.add_option("--sweep-huge-pages", sweep_huge_pages,
+                     "benchmark huge page settings, default | on | off");
+  opt_sweep_huge_pages->set_default_val("off on");
+
   // run parser
   try {
     app.parse(argc, argv);
   } catch (const CLI::ParseError& e) {
+    // job fails, it does not run with defaults of invalid options
+    if (job_params != nullptr)
+      throw std::invalid_argument(std::string("batch: invalid job options, ") +
+                                  e.what());
     app.exit(e);
   }
 
@@ -132,6 +354,10 @@ bool UserInterface::parse(int argc, char** argv) {
   bool has_command(opt_cmd->count() > 0);
   bool has_params(opt_params->count() > 0);
 
+  // parameters of batch job are not options, e.g. salt "-x" stays salt
+  if (job_params != nullptr) has_params = true;
+  const UserArguments& params = (job_params ? *job_params : cli_params);
+
   // process parser results
   do {
     // help -> exit
@@ -148,6 +374,23 @@ bool UserInterface::parse(int argc, char** argv) {
 
     // init network
     cid_ = CoinId(coin);
+    threads_ = threads;
+    interleave_ = interleave;
+    huge_pages_ = huge_pages;
+    scrypt_kernel_ = kernel;
+    profile_ = (profile == "none" ? "" : profile);
+    if (format == "ndjson")
+      format_ = OutputFormat::kNdJson;
+    else if (format == "csv")
+      format_ = OutputFormat::kCsv;
+    else if (format == "binary")
+      format_ = OutputFormat::kBinary;
+    output_ = output;
+    progress_ = progress;
+    stats_ = stats || perf_counters;
+    perf_counters_ = perf_counters;
+    root_cache_ = root_cache;
+    deadline_ms_ = deadline;
 
     // no command, select default operation, parameters -> exit
     if (!has_command) {
@@ -168,6 +411,16 @@ bool UserInterface::parse(int argc, char** argv) {
       oper_ = OPER__GENERATE_WALLET_HD;
     else if (cmd == Test)
       oper_ = OPER_TEST;
+    else if (cmd == GenerateAddressesXpub)
+      oper_ = OPER_GENERATE_ADDRESSES_XPUB;
+    else if (cmd == BatchJobs)
+      oper_ = OPER_BATCH;
+    else if (cmd == ServeJobs)
+      oper_ = OPER_SERVE;
+    else if (cmd == BenchThroughput)
+      oper_ = OPER_BENCH;
+    else if (cmd == TuneEngine)
+      oper_ = OPER_TUNE;
     else {
       // unknown command ->  exit
       oper_ = OPER_UNDEF;
@@ -180,7 +433,12 @@ bool UserInterface::parse(int argc, char** argv) {
     AttachAddress = 3,
     GenerateWalletSD = 4,
     GenerateWalletBIP32 = 5,
-    Test = 6
+    Test = 6,
+    GenerateAddressesXpub = 7,
+    BatchJobs = 8,
+    ServeJobs = 9,
+    BenchThroughput = 10,
+    TuneEngine = 11
     */
     switch (cmd) {
       default:
@@ -274,6 +532,9 @@ bool UserInterface::parse(int argc, char** argv) {
           temp.magic_ = std::stoi(params.at(2));
           temp.keys_ = std::stoi(params.at(3));
           temp.is_watch_only_ = (std::stoi(params.at(4)) == 1);
+          temp.version_ = dts_version;
+          temp.from_ = from;
+          if (opt_count->count() > 0) temp.keys_ = count;
           dts_wallet_ = temp;
         } catch (std::exception& e) {
           std::stringstream ss;
@@ -308,9 +569,132 @@ bool UserInterface::parse(int argc, char** argv) {
         }
         break;
       case Test:
+        // {[spec-file | spec-directory ...]}, default is directory test
+        test_specs_ = (has_params ? params : UserArguments{"test"});
+        break;
+      case GenerateAddressesXpub:
+        // {extended-public-key chain first-index key-count}
+        if (!has_params) {
+          std::stringstream ss;
+          ss << oper_ << " parameters {extended-public-key chain first-index "
+                         "key-count} missing";
+          throw std::invalid_argument(ss.str());
+        }
+        try {
+          pwd_.clear();
+          salt_.clear();
+          UserInterface::WatchXpub temp;
+          temp.xpub_ = params.at(0);
+          temp.chain_ = std::stoul(params.at(1));
+          temp.first_ = std::stoul(params.at(2));
+          temp.keys_ = std::stoul(params.at(3));
+          xpub_watch_ = temp;
+        } catch (std::exception& e) {
+          std::stringstream ss;
+          ss << oper_ << " invalid parameter set {extended-public-key chain "
+                         "first-index key-count}";
+          throw std::invalid_argument(ss.str());
+        }
+        break;
+      case BatchJobs:
+        // {jobs-file | -}
+        if (!has_params) {
+          std::stringstream ss;
+          ss << oper_ << " parameters {jobs-file | -} missing";
+          throw std::invalid_argument(ss.str());
+        }
+        pwd_.clear();
+        salt_.clear();
+        {
+          UserInterface::Batch temp;
+          temp.file_ = params.at(0);
+          temp.ordered_ = (batch_order == "input");
+          batch_ = temp;
+        }
+        break;
+      case ServeJobs:
+        // {socket-path}
+        if (!has_params) {
+          std::stringstream ss;
+          ss << oper_ << " parameters {socket-path} missing";
+          throw std::invalid_argument(ss.str());
+        }
+        pwd_.clear();
+        salt_.clear();
+        {
+          UserInterface::Serve temp;
+          temp.socket_ = params.at(0);
+          temp.max_queue_ = max_queue;
+          serve_ = temp;
+        }
+        break;
+      case BenchThroughput:
+        // {key-count [random | dts ...]}
+        if (!has_params) {
+          std::stringstream ss;
+          ss << oper_ << " parameters {key-count [random | dts ...]} missing";
+          throw std::invalid_argument(ss.str());
+        }
+        pwd_.clear();
+        salt_.clear();
+        try {
+          UserInterface::Bench temp;
+          temp.keys_ = std::stoul(params.at(0));
+          temp.paths_.assign(params.begin() + 1, params.end());
+          if (temp.paths_.empty()) temp.paths_ = {"random", "dts"};
+          for (auto& p : temp.paths_)
+            if (p != "random" && p != "dts") throw std::invalid_argument(p);
+          for (auto l : sweep_interleave)
+            if (l < 1 || l > 4) throw std::out_of_range("interleave");
+          for (auto& h : sweep_huge_pages)
+            if (h != "default" && h != "on" && h != "off")
+              throw std::invalid_argument(h);
+          temp.threads_ = sweep_threads;
+          temp.interleave_ = sweep_interleave;
+          temp.huge_pages_ = sweep_huge_pages;
+          bench_ = temp;
+        } catch (std::exception& e) {
+          std::stringstream ss;
+          ss << oper_ << " invalid parameter set {key-count [random | dts "
+                         "...]}";
+          throw std::invalid_argument(ss.str());
+        }
+        break;
+      case TuneEngine:
+        // {}, profile is written into file of option --profile
+        pwd_.clear();
+        salt_.clear();
+        if (profile_.empty())
+          throw std::invalid_argument(oper_ + " profile file missing");
         break;
     }
   } while (false);
 
+  // bulk commands and daemon run tuned settings of this machine, options
+  // given on command line take precedence
+  bool bulk = (oper_ == OPER_GENERATE_COIN_RANDOM ||
+               oper_ == OPER__GENERATE_WALLET_DTS || oper_ == OPER_TEST ||
+               oper_ == OPER_BATCH || oper_ == OPER_SERVE);
+  if (bulk && tuned != nullptr) {
+    // batch job, profile was loaded once by batch or daemon
+    tuned_ = *tuned;
+  } else if (bulk && !profile_.empty()) {
+    MachineProfile loaded(profile_);
+    if (loaded.load()) tuned_ = loaded;
+  }
+  if (tuned_) {
+    const MachineProfile& settings = tuned_.value();
+    std::vector<std::string> kernels = WarpKeyGenerator::kernels();
+    if (opt_threads->count() == 0) threads_ = settings.threads_;
+    if (opt_interleave->count() == 0 && settings.interleave_ >= 1 &&
+        settings.interleave_ <= 4)
+      interleave_ = settings.interleave_;
+    if (opt_huge_pages->count() == 0) huge_pages_ = settings.huge_pages_;
+    if (opt_kernel->count() == 0 &&
+        std::find(kernels.begin(), kernels.end(), settings.kernel_) !=
+            kernels.end())
+      scrypt_kernel_ = settings.kernel_;
+  }
+
   return (oper_ != OPER_UNDEF);
 }
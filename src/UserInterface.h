@@ -25,6 +25,8 @@
 #include <string>
 
 #include "CoinKeyPair.h"
+#include "KeyWriter.h"
+#include "MachineProfile.h"
 #include "RandomSeedGenerator.h"
 
 /// attach-address -p <password length> <salt> <address>
@@ -45,9 +47,25 @@ const std::string OPER__GENERATE_WALLET_DTS(
 const std::string OPER__GENERATE_WALLET_HD(
     "generate-wallet-deterministic-bib32");
 
-/// test -p <test identifier> <test vector file name>
+/// generate-addresses-xpub -p <extended public key> <chain> <first index>
+/// <key count>
+const std::string OPER_GENERATE_ADDRESSES_XPUB("generate-addresses-xpub");
+
+/// batch -p <jobs file | -> , one JSON derivation job per line
+const std::string OPER_BATCH("batch");
+
+/// serve -p <socket path> , JSONL jobs over Unix domain socket
+const std::string OPER_SERVE("serve");
+
+/// test -p [spec file | spec directory ...]
 const std::string OPER_TEST("test");
 
+/// bench -p <key count> [random | dts ...] , throughput of configurations
+const std::string OPER_BENCH("bench");
+
+/// tune , calibrates KDF engine and writes machine profile
+const std::string OPER_TUNE("tune");
+
 /// default operation, no parameters (generate keypair with fixed password:salt)
 const std::string OPER_DEFAULT("default");
 
@@ -55,6 +73,16 @@ const std::string OPER_UNDEF("undef");
 
 using UserArguments = std::vector<std::string>;
 
+/// maximum key count of commands producing key lists
+const unsigned int MAX_KEYS{100000000};
+
+/// maximum key count when key list is built into single JSON document
+const unsigned int MAX_KEYS_JSON{999};
+
+/// maximum key count of random keys when passwords are short enough that
+/// duplicates must be filtered, drawn passwords are then kept in memory
+const unsigned int MAX_KEYS_UNIQUE{1000000};
+
 /// \class UserInterface
 /// \brief Processes user input and displays command results.
 ///
@@ -66,6 +94,15 @@ class UserInterface {
 
   bool parse(int argc, char** argv);
 
+  /// \brief Parses batch job. 'options' are command line options of job,
+  /// limited to wallet options, 'params' are its command parameters taken
+  /// as they are, never as options. 'tuned' is machine profile of batch or
+  /// daemon run, job does not read profile file. Throws on invalid options
+  /// and on key counts above MAX_KEYS_JSON.
+  bool parseJob(const std::string& network, const std::string& command,
+                const UserArguments& options, const UserArguments& params,
+                const std::experimental::optional<MachineProfile>& tuned);
+
   void show(const std::ostringstream& result);
 
   UserArguments arguments_;
@@ -82,10 +119,51 @@ class UserInterface {
   /// salt
   Password salt_;
 
+  /// worker threads for bulk commands, 0 = select automatically
+  unsigned int threads_;
+
+  /// keys derived by one worker task, their scrypt runs are interleaved
+  unsigned int interleave_;
+
+  /// transparent huge pages of scrypt memory, default | on | off
+  std::string huge_pages_;
+
+  /// scrypt kernel name, empty = best available
+  std::string scrypt_kernel_;
+
+  /// machine profile file, empty = none
+  std::string profile_;
+
+  /// profile whose settings were applied, options not given on command
+  /// line were read from it
+  std::experimental::optional<MachineProfile> tuned_;
+
+  /// output format, key lists are streamed with ndjson and csv
+  OutputFormat format_;
+
+  /// output file name, required by binary format
+  std::string output_;
+
+  /// report progress of bulk commands to stderr
+  bool progress_;
+
+  /// add per-stage timing to command result
+  bool stats_;
+
+  /// add per-stage hardware counters to stats, implies stats
+  bool perf_counters_;
+
+  /// root key cache file, empty if not used
+  std::string root_cache_;
+
+  /// default deadline of batch and daemon jobs in ms, 0 = none
+  unsigned int deadline_ms_;
+
   /// random key generation parameters
   struct Random {
     operator bool() const {
-      return (pwd_len_ >= 2 && pwd_len_ < 65535 && keys_ >= 1 && keys_ < 1000);
+      return (pwd_len_ >= 2 && pwd_len_ < 65535 && keys_ >= 1 &&
+              keys_ <= MAX_KEYS);
     }
     uint16_t pwd_len_;
     unsigned int keys_;
@@ -104,10 +182,15 @@ class UserInterface {
 
   /// simple deterministic wallet parameters
   struct WalletDTS {
-    operator bool() const { return (keys_ >= 1 && keys_ < 1000); }
+    operator bool() const {
+      return (keys_ >= 1 && keys_ <= MAX_KEYS &&
+              (version_ == 1 || version_ == 2));
+    }
     unsigned int magic_;
     unsigned int keys_;
     bool is_watch_only_;
+    unsigned int version_;  /// 1 = child by WarpWallet, 2 = by HMAC-SHA256
+    unsigned int from_;     /// offset of first generated child
     std::string root_;
   };
   std::experimental::optional<WalletDTS> dts_wallet_;
@@ -115,23 +198,73 @@ class UserInterface {
   /// hierarchical deterministic wallet parameters
   struct WalletHD {
     operator bool() const {
-      return (external_keys_ >= 1 && external_keys_ < 1000 &&
-              internal_keys_ < 1000);
+      return (external_keys_ >= 1 && external_keys_ <= MAX_KEYS &&
+              internal_keys_ <= MAX_KEYS);
     }
     bool is_watch_only_;
     unsigned int external_keys_;
     unsigned int internal_keys_;
+    std::string account_path_;
+    std::string account_xpub_;
+    std::string account_xprv_;
   };
   std::experimental::optional<WalletHD> hd_wallet;
 
-  /// file name containing test vectors
-  std::experimental::optional<std::string> fnTest_;
+  /// watch-only address derivation parameters, children of xpub/chain
+  struct WatchXpub {
+    operator bool() const {
+      return (!xpub_.empty() && chain_ < 0x80000000 && keys_ >= 1 &&
+              keys_ <= MAX_KEYS && first_ <= 0x80000000 - keys_);
+    }
+    std::string xpub_;
+    unsigned int chain_;
+    unsigned int first_;
+    unsigned int keys_;
+  };
+  std::experimental::optional<WatchXpub> xpub_watch_;
+
+  /// batch job parameters
+  struct Batch {
+    operator bool() const { return !file_.empty(); }
+    std::string file_;  /// JSONL job file, "-" = standard input
+    bool ordered_;      /// results in input order, otherwise completion order
+  };
+  std::experimental::optional<Batch> batch_;
+
+  /// daemon parameters
+  struct Serve {
+    operator bool() const { return !socket_.empty() && max_queue_ >= 1; }
+    std::string socket_;     /// Unix domain socket path
+    unsigned int max_queue_;  /// jobs queued or running, others rejected
+  };
+  std::experimental::optional<Serve> serve_;
+
+  /// test vector files or directories of *.spec.json files
+  UserArguments test_specs_;
+
+  /// benchmark parameters, configurations are all combinations of sweeps
+  struct Bench {
+    operator bool() const {
+      return (keys_ >= 1 && keys_ <= MAX_KEYS && !paths_.empty() &&
+              !interleave_.empty() && !huge_pages_.empty());
+    }
+    unsigned int keys_;                 /// keys of each configuration
+    UserArguments paths_;               /// random | dts
+    std::vector<unsigned int> threads_;  /// empty = powers of two to cores
+    std::vector<unsigned int> interleave_;
+    UserArguments huge_pages_;
+  };
+  std::experimental::optional<Bench> bench_;
 
   /// file name containing words for passphrase dictionary
   std::experimental::optional<std::string> fnDict_;
 
   /// output stream to save or display
   std::ostream& out_;
+
+ private:
+  bool parseArgs(int argc, char** argv, const UserArguments* job_params,
+                 const std::experimental::optional<MachineProfile>* tuned);
 };
 
 #endif  // USERINTERFACE_H
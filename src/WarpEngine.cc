@@ -0,0 +1,105 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+
+#include "SecureMemory.h"
+#include "WarpEngine.h"
+#include "WarpKeyGenerator.h"
+
+WarpEngine::WarpEngine(unsigned int threads)
+    : owned_(std::make_unique<ThreadPool>(
+          WarpKeyGenerator::concurrency(threads))),
+      pool_(*owned_),
+      pending_(0) {
+  WarpKeyGenerator::warmUp(static_cast<unsigned int>(pool_.size()));
+}
+
+WarpEngine::WarpEngine(ThreadPool& pool) : pool_(pool), pending_(0) {}
+
+WarpEngine::~WarpEngine() { wait(); }
+
+void WarpEngine::submit(CoinId id, const Password& pwd, const Password& salt,
+                        Callback done,
+                        std::shared_ptr<const CancelToken> cancel) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.push_back(Request{id, pwd, salt, std::move(done), cancel});
+    pending_++;
+  }
+  pool_.submit([this] { runNext(); });
+}
+
+std::future<WarpKeyResult> WarpEngine::submit(
+    CoinId id, const Password& pwd, const Password& salt,
+    std::shared_ptr<const CancelToken> cancel) {
+  auto promise = std::make_shared<std::promise<WarpKeyResult>>();
+  std::future<WarpKeyResult> future = promise->get_future();
+  submit(id, pwd, salt,
+         [promise](const WarpKeyResult& result) {
+           if (result.error_)
+             promise->set_exception(result.error_);
+           else
+             promise->set_value(result);
+         },
+         cancel);
+  return future;
+}
+
+size_t WarpEngine::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_;
+}
+
+void WarpEngine::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void WarpEngine::runNext() {
+  Request req{CoinId::kBitCoin, {}, {}, nullptr, nullptr};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    req = std::move(requests_.front());
+    requests_.pop_front();
+  }
+
+  WarpKeyResult result(req.id_);
+  try {
+    WarpKeyGenerator key_gen;
+    result.status_ =
+        key_gen.generate(req.pwd_, req.salt_, result.secret_, req.cancel_.get());
+    if (result.status_ == WarpKeyGenerator::kOk)
+      result.coin_.create(result.secret_.data(), result.secret_.size());
+  } catch (...) {
+    result.error_ = std::current_exception();
+  }
+  secureWipe(req.pwd_.data(), req.pwd_.size());
+
+  // exception of callback must not stop the worker
+  try {
+    if (req.done_) req.done_(result);
+  } catch (...) {
+  }
+  secureWipe(result.secret_.data(), result.secret_.size());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_--;
+  idle_.notify_all();
+}
@@ -0,0 +1,111 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WARPENGINE_H
+#define WARPENGINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "CancelToken.h"
+#include "CoinKeyPair.h"
+#include "RandomSeedGenerator.h"
+#include "ThreadPool.h"
+
+/// \brief Completed key derivation request of WarpEngine.
+struct WarpKeyResult {
+  WarpKeyResult(CoinId id) : status_(0), coin_(id) {}
+
+  int status_;                 /// WarpKeyGenerator::Status
+  std::exception_ptr error_;   /// set when derivation failed
+  SecretKey secret_;           /// WarpWallet key, valid with status kOk
+  CoinKeyPair coin_;           /// address and keys, valid with status kOk
+};
+
+///
+/// \brief Asynchronous key derivation for embedding the core into services.
+///
+/// Requests are queued without limit and run by a shared worker pool in
+/// submission order, a pending request costs only its queue entry. The
+/// number of parallel derivations is limited by available memory as in
+/// bulk commands. Destructor waits until all requests have completed.
+///
+class WarpEngine {
+ public:
+  using Callback = std::function<void(const WarpKeyResult&)>;
+
+  /// \brief Engine with pool of its own, 0 threads = all cores.
+  explicit WarpEngine(unsigned int threads = 0);
+
+  /// \brief Engine running derivations in given pool.
+  explicit WarpEngine(ThreadPool& pool);
+
+  virtual ~WarpEngine();
+
+  WarpEngine(const WarpEngine&) = delete;
+  WarpEngine& operator=(const WarpEngine&) = delete;
+
+  /// \brief Queues derivation of key pair of password and salt, 'done' is
+  /// called from a worker thread on completion. Request stops with status
+  /// kCancelled or kTimeout when optional 'cancel' token fires.
+  void submit(CoinId id, const Password& pwd, const Password& salt,
+              Callback done,
+              std::shared_ptr<const CancelToken> cancel = nullptr);
+
+  /// \brief Queues derivation, future throws when derivation failed.
+  std::future<WarpKeyResult> submit(
+      CoinId id, const Password& pwd, const Password& salt,
+      std::shared_ptr<const CancelToken> cancel = nullptr);
+
+  /// \brief Number of parallel derivations.
+  size_t threads() const { return pool_.size(); }
+
+  /// \brief Number of requests queued or running.
+  size_t pending() const;
+
+  /// \brief Waits until all requests have completed.
+  void wait();
+
+ private:
+  struct Request {
+    CoinId id_;
+    Password pwd_;
+    Password salt_;
+    Callback done_;
+    std::shared_ptr<const CancelToken> cancel_;
+  };
+
+  void runNext();
+
+  std::unique_ptr<ThreadPool> owned_;
+  ThreadPool& pool_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable idle_;
+  std::deque<Request> requests_;  /// waiting for worker, oldest first
+  size_t pending_;                /// queued or running
+};
+
+#endif  // WARPENGINE_H
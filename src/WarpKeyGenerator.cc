@@ -21,8 +21,14 @@
 #include <assert.h>
 #include <algorithm>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
 
 #ifdef USE_OPENSSL
 #ifdef __cplusplus
@@ -32,13 +38,112 @@ extern "C" {
 }
 #endif
 #else
-#include "scrypt.h"
-#include "sha256.h"
-using namespace cppcrypto;
+#include "ScryptEngine.h"
+#include "Sha256Engine.h"
 #endif
 
+#include "CancelToken.h"
+#include "SecureMemory.h"
+#include "StageStats.h"
 #include "WarpKeyGenerator.h"
 
+constexpr uint32_t WarpKeyGenerator::kScryptN;
+constexpr uint32_t WarpKeyGenerator::kScryptR;
+constexpr size_t WarpKeyGenerator::kScryptMemory;
+
+namespace {
+/// domain separation bytes appended to password and salt
+const uint8_t SCRYPT_DOMAIN{0x01};
+const uint8_t PBKDF2_DOMAIN{0x02};
+
+/// \brief Returns memory available for new allocations in bytes.
+unsigned long long availableMemory() {
+  // prefer kernel estimate, it accounts reclaimable page cache
+  std::ifstream meminfo("/proc/meminfo");
+  std::string name;
+  unsigned long long kb;
+  while (meminfo >> name >> kb) {
+    if (name == "MemAvailable:") return kb * 1024;
+    meminfo.ignore(256, '\n');
+  }
+  long pages = sysconf(_SC_AVPHYS_PAGES);
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (pages > 0 && page_size > 0)
+    return static_cast<unsigned long long>(pages) * page_size;
+  return 0;
+}
+}
+
+unsigned int WarpKeyGenerator::concurrency(unsigned int requested,
+                                           unsigned int lanes) {
+  unsigned int n = requested;
+  if (n == 0) n = std::max(1U, std::thread::hardware_concurrency());
+
+  // leave headroom of one scrypt buffer for the rest of the process
+  unsigned long long mem = availableMemory();
+  if (mem != 0) {
+    unsigned long long fit = mem / (kScryptMemory * std::max(1U, lanes));
+    fit = (fit > 1 ? fit - 1 : 1);
+    if (fit < n) n = static_cast<unsigned int>(fit);
+  }
+  return n;
+}
+
+void WarpKeyGenerator::warmUp(unsigned int count) {
+#ifndef USE_OPENSSL
+  size_t idle = ScryptArenaPool::instance().idle();
+  if (count > idle)
+    ScryptArenaPool::instance().reserve(count - idle, kScryptN, kScryptR, true);
+#else
+  (void)count;
+#endif
+}
+
+void WarpKeyGenerator::coolDown() {
+#ifndef USE_OPENSSL
+  ScryptArenaPool::instance().clear();
+#endif
+}
+
+void WarpKeyGenerator::setHugePages(const std::string &mode) {
+  if (mode != "default" && mode != "on" && mode != "off")
+    throw std::invalid_argument("WarpKeyGenerator::invalid huge page mode");
+#ifndef USE_OPENSSL
+  ScryptArenaPool::instance().setHugePages(
+      mode == "on" ? ScryptArena::HugePages::kOn
+                   : (mode == "off" ? ScryptArena::HugePages::kOff
+                                    : ScryptArena::HugePages::kDefault));
+#endif
+}
+
+std::vector<std::string> WarpKeyGenerator::kernels() {
+#ifdef USE_OPENSSL
+  return {"openssl"};
+#else
+  std::vector<std::string> names;
+  for (ScryptKernel k : scryptKernels()) names.push_back(scryptKernelName(k));
+  return names;
+#endif
+}
+
+std::string WarpKeyGenerator::kernel() {
+#ifdef USE_OPENSSL
+  return "openssl";
+#else
+  return scryptKernelName(scryptKernel());
+#endif
+}
+
+void WarpKeyGenerator::setKernel(const std::string &name) {
+#ifndef USE_OPENSSL
+  for (ScryptKernel k : scryptKernels())
+    if (name == scryptKernelName(k)) return setScryptKernel(k);
+#endif
+  if (name != kernel())
+    throw std::invalid_argument("WarpKeyGenerator::unknown scrypt kernel " +
+                                name);
+}
+
 /* Warp crypto key generation algorithm
  * ***************************************************************************
  * s1 = scrypt.hash(password=phrase+'\x01', salt=saltPhrase+'\x01',
@@ -49,54 +154,145 @@ using namespace cppcrypto;
  * key_hex = hexlify(key)
  */
 
-int WarpKeyGenerator::generate(const ByteVect &pwd, const ByteVect &salt,
-                               SecretKey &out) {
+int WarpKeyGenerator::generate(ByteView pwd, ByteView salt, SecretKey &out,
+                               const CancelToken *cancel) {
+  SecretKey s1;
+  SecretKey s2;
+  /// \todo: run algorithms in separate threads
+  int status = scryptSeed(pwd, salt, s1, cancel);
+  if (status == kOk) status = pbkdf2Seed(pwd, salt, s2, cancel);
+  if (status == kOk) {
+    // do XOR using s1 and s2 and save results to out buf
+    std::transform(s1.begin(), s1.end(), s2.begin(), out.begin(),
+                   std::bit_xor<uint8_t>());
+  }
+  secureWipe(s1.data(), s1.size());
+  secureWipe(s2.data(), s2.size());
+  return status;
+}
+
+int WarpKeyGenerator::generate(const ByteView *pwds, size_t count,
+                               ByteView salt, SecretKey *outs,
+                               const CancelToken *cancel) {
+#ifdef USE_OPENSSL
+  for (size_t i = 0; i < count; i++) {
+    int status = generate(pwds[i], salt, outs[i], cancel);
+    if (status != kOk) return status;
+  }
+  return kOk;
+#else
+  for (size_t i = 0; i < count; i++)
+    if (pwds[i].size() < 2)
+      throw std::invalid_argument("WarpKeyGenerator::password too short");
+
+  const ByteView domain(&SCRYPT_DOMAIN, 1);
+  for (size_t first = 0; first < count; first += SCRYPT_MAX_LANES) {
+    const size_t lanes = std::min(SCRYPT_MAX_LANES, count - first);
+    std::vector<ScryptArenaPool::Lease> leases;
+    std::vector<std::unique_ptr<HmacSha256>> macs;
+    ScryptArena *arenas[SCRYPT_MAX_LANES];
+    HmacSha256 *prfs[SCRYPT_MAX_LANES];
+    uint8_t *s1[SCRYPT_MAX_LANES];
+    for (size_t i = 0; i < lanes; i++) {
+      leases.push_back(
+          ScryptArenaPool::instance().acquire(kScryptN, kScryptR));
+      macs.emplace_back(new HmacSha256(pwds[first + i], domain));
+      arenas[i] = leases.back().get();
+      prfs[i] = macs.back().get();
+      s1[i] = outs[first + i].data();
+    }
+    int status = kOk;
+    try {
+      if (cancel != nullptr) cancel->check();
+      StageTimer timer(Stage::kScrypt, lanes);
+      scrypt(prfs, salt, domain, s1, outs[first].size(), arenas, lanes,
+             cancel);
+    } catch (OperationCancelled &e) {
+      status = (e.status() == CancelToken::Status::kTimeout ? kTimeout
+                                                            : kCancelled);
+    }
+    // outs hold s1 of the lanes, XOR them with s2
+    SecretKey s2;
+    for (size_t i = 0; i < lanes && status == kOk; i++) {
+      SecretKey &out = outs[first + i];
+      status = pbkdf2Seed(pwds[first + i], salt, s2, cancel);
+      if (status == kOk)
+        std::transform(out.begin(), out.end(), s2.begin(), out.begin(),
+                       std::bit_xor<uint8_t>());
+    }
+    secureWipe(s2.data(), s2.size());
+    if (status != kOk) {
+      for (size_t i = 0; i < count; i++)
+        secureWipe(outs[i].data(), outs[i].size());
+      return status;
+    }
+  }
+  return kOk;
+#endif
+}
+
+int WarpKeyGenerator::scryptSeed(ByteView pwd, ByteView salt, SecretKey &out,
+                                 const CancelToken *cancel) {
   // sanity checks
   if (pwd.size() < 2)
     throw std::invalid_argument("WarpKeyGenerator::password too short");
 
-  uint8_t s1[32];
-  uint8_t s2[32];
-
-  /// \todo: run algorithms in separate threads
-  {
-    // do scrypt
-    std::vector<uint8_t> a(pwd);
-    a.push_back('\01');
-    std::vector<uint8_t> b(salt);
-    b.push_back('\01');
-
+  StageTimer timer(Stage::kScrypt);
+  try {
+    if (cancel != nullptr) cancel->check();
 #ifdef USE_OPENSSL
-    openssl_scrypt(a.data(), a.size(), b.data(), b.size(), (1 << 18), 8, 1, s1,
-                   sizeof(s1));
+    SecureBytes a(pwd.begin(), pwd.end());
+    a.push_back(SCRYPT_DOMAIN);
+    SecureBytes b(salt.begin(), salt.end());
+    b.push_back(SCRYPT_DOMAIN);
+    openssl_scrypt(a.data(), a.size(), b.data(), b.size(), kScryptN, kScryptR,
+                   1, out.data(), out.size());
+    if (cancel != nullptr) cancel->check();
 #else
-    hmac h(sha256(), a.data(), a.size());
-    scrypt(h, b.data(), b.size(), (1 << 18), 8, 1, s1, sizeof(s1));
+    // domain byte is streamed after password and salt, inputs are not
+    // copied, arena is returned to pool warm for the next key and wiped if
+    // cancelled
+    const ByteView domain(&SCRYPT_DOMAIN, 1);
+    ScryptArenaPool::Lease arena =
+        ScryptArenaPool::instance().acquire(kScryptN, kScryptR);
+    HmacSha256 prf(pwd, domain);
+    scrypt(prf, salt, domain, 1, out.data(), out.size(), *arena, cancel);
 #endif
+  } catch (OperationCancelled &e) {
+    secureWipe(out.data(), out.size());
+    return (e.status() == CancelToken::Status::kTimeout ? kTimeout
+                                                         : kCancelled);
   }
-  {
-    // do pbkdf2
-    std::vector<uint8_t> a(pwd);
-    a.push_back('\02');
-    std::vector<uint8_t> b(salt);
-    b.push_back('\02');
+  return kOk;
+}
 
+int WarpKeyGenerator::pbkdf2Seed(ByteView pwd, ByteView salt, SecretKey &out,
+                                 const CancelToken *cancel) {
+  // sanity checks
+  if (pwd.size() < 2)
+    throw std::invalid_argument("WarpKeyGenerator::password too short");
+
+  StageTimer timer(Stage::kPbkdf2);
+  try {
+    if (cancel != nullptr) cancel->check();
 #ifdef USE_OPENSSL
-    openssl_pbkdf2(a.data(), a.size(), b.data(), b.size(), (1 << 16), s2,
-                   sizeof(s2));
+    SecureBytes a(pwd.begin(), pwd.end());
+    a.push_back(PBKDF2_DOMAIN);
+    SecureBytes b(salt.begin(), salt.end());
+    b.push_back(PBKDF2_DOMAIN);
+    openssl_pbkdf2(a.data(), a.size(), b.data(), b.size(), (1 << 16),
+                   out.data(), out.size());
 #else
-    hmac h(sha256(), a.data(), a.size());
-    pbkdf2(h, b.data(), b.size(), (1 << 16), s2, sizeof(s2));
+    const ByteView domain(&PBKDF2_DOMAIN, 1);
+    HmacSha256 prf(pwd, domain);
+    prf.pbkdf2(salt, domain, (1 << 16), out.data(), out.size(), cancel);
 #endif
+  } catch (OperationCancelled &e) {
+    secureWipe(out.data(), out.size());
+    return (e.status() == CancelToken::Status::kTimeout ? kTimeout
+                                                         : kCancelled);
   }
-
-  // do XOR using s1 and s2 and save results to out buf
-  uint8_t key[32];
-  std::transform(std::begin(s1), std::end(s1), std::begin(s2), std::begin(key),
-                 std::bit_xor<uint8_t>());
-
-  std::copy(std::begin(key), std::end(key), std::begin(out));
-  return 0;
+  return kOk;
 }
 
 #ifdef USE_OPENSSL
@@ -22,11 +22,16 @@
 #define WARPKEYGENERATOR_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include <vector>
 
+#include "ByteView.h"
 #include "CoinKeyPair.h"
 
+class CancelToken;
+
 /// \brief The WarpKeyGenerator class
 class WarpKeyGenerator {
  public:
@@ -35,7 +40,65 @@ class WarpKeyGenerator {
 
   void init();
 
-  int generate(const ByteVect& pwd, const ByteVect& salt, SecretKey& out);
+  /// \brief Result of generate()
+  enum Status : int { kOk = 0, kCancelled = 1, kTimeout = 2 };
+
+  /// \brief Generates WarpWallet key of password and salt. Returns kCancelled
+  /// or kTimeout when 'cancel' fires, scratch memory is wiped then.
+  int generate(ByteView pwd, ByteView salt, SecretKey& out,
+               const CancelToken* cancel = nullptr);
+
+  /// \brief Generates keys of 'count' passwords sharing salt, scrypt of up
+  /// to SCRYPT_MAX_LANES passwords is interleaved in calling thread. Uses
+  /// 'count' times the scrypt memory of generate().
+  int generate(const ByteView* pwds, size_t count, ByteView salt,
+               SecretKey* outs, const CancelToken* cancel = nullptr);
+
+  /// \brief First seed of generate(), scrypt of password and salt with
+  /// domain byte 0x01.
+  int scryptSeed(ByteView pwd, ByteView salt, SecretKey& out,
+                 const CancelToken* cancel = nullptr);
+
+  /// \brief Second seed of generate(), PBKDF2-HMAC-SHA256 of password and
+  /// salt with domain byte 0x02. Key is XOR of the seeds.
+  int pbkdf2Seed(ByteView pwd, ByteView salt, SecretKey& out,
+                 const CancelToken* cancel = nullptr);
+
+  /// scrypt cost parameters of WarpWallet
+  static constexpr uint32_t kScryptN{1 << 18};
+  static constexpr uint32_t kScryptR{8};
+
+  /// scratch memory used by one scrypt run (128 * r * N bytes)
+  static constexpr size_t kScryptMemory{128 * kScryptR * kScryptN};
+
+  /// \brief Number of generate() calls that can run in parallel, limited by
+  /// requested thread count (0 = all cores) and available memory when each
+  /// call interleaves 'lanes' keys.
+  static unsigned int concurrency(unsigned int requested = 0,
+                                  unsigned int lanes = 1);
+
+  /// \brief Maps and prefaults scrypt memory for 'count' parallel generate()
+  /// calls, so that first keys do not pay for page faults.
+  static void warmUp(unsigned int count);
+
+  /// \brief Wipes and unmaps idle scrypt memory of warmUp() and earlier
+  /// generate() calls.
+  static void coolDown();
+
+  /// \brief Transparent huge pages of scrypt memory mapped later, "default"
+  /// keeps system policy, "on" or "off" advise it. Throws
+  /// std::invalid_argument on other values.
+  static void setHugePages(const std::string& mode);
+
+  /// \brief Names of scrypt kernels compiled in, best last.
+  static std::vector<std::string> kernels();
+
+  /// \brief Name of scrypt kernel used by generate().
+  static std::string kernel();
+
+  /// \brief Selects scrypt kernel by name, throws std::invalid_argument
+  /// when kernel is not available.
+  static void setKernel(const std::string& name);
 
  private:
 #ifdef USE_OPENSSL
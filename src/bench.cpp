@@ -0,0 +1,324 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CLI.hpp"
+#include "CoinEncoding.h"
+#include "KeySerializer.h"
+#include "ScryptEngine.h"
+#include "Secp256k1.h"
+#include "Sha256Engine.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// WarpWallet cost parameters
+const uint64_t SCRYPT_N{1 << 18};
+const uint32_t SCRYPT_R{8};
+const uint32_t PBKDF2_ITERATIONS{1 << 16};
+
+/// items of one run of the fast primitives
+const size_t BATCH{1024};
+const size_t EC_BATCH{256};
+
+/// \brief One primitive of one backend.
+struct Benchmark {
+  std::string name_;     /// primitive
+  std::string backend_;  /// implementation and SIMD level
+  std::string unit_;     /// item processed by primitive
+  uint64_t items_;       /// items of one run
+  std::function<void()> run_;
+};
+
+/// \brief Statistics of run times in milliseconds.
+struct Stats {
+  unsigned int runs_;
+  double min_;
+  double median_;
+  double mean_;
+  double stddev_;
+  double max_;
+};
+
+Stats measure(const Benchmark& b, unsigned int warmup, unsigned int runs) {
+  for (unsigned int i = 0; i < warmup; i++) b.run_();
+  std::vector<double> ms(runs);
+  for (unsigned int i = 0; i < runs; i++) {
+    Clock::time_point start = Clock::now();
+    b.run_();
+    ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count();
+  }
+  std::sort(ms.begin(), ms.end());
+  Stats s;
+  s.runs_ = runs;
+  s.min_ = ms.front();
+  s.max_ = ms.back();
+  s.median_ = (runs % 2 ? ms[runs / 2] : (ms[runs / 2 - 1] + ms[runs / 2]) / 2);
+  s.mean_ = std::accumulate(ms.begin(), ms.end(), 0.0) / runs;
+  double var{0};
+  for (double m : ms) var += (m - s.mean_) * (m - s.mean_);
+  s.stddev_ = (runs > 1 ? std::sqrt(var / (runs - 1)) : 0.0);
+  return s;
+}
+
+std::string cpuModel() {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      size_t pos = line.find(':');
+      if (pos != std::string::npos) return line.substr(pos + 2);
+    }
+  }
+  return "unknown";
+}
+
+///
+/// \brief Inputs shared by benchmarks.
+///
+/// Inputs are fixed, so that every run does the same work and results of
+/// builds can be compared.
+///
+struct Inputs {
+  Inputs() : arena_(SCRYPT_N, SCRYPT_R), block_(128 * SCRYPT_R, 0x5a) {
+    for (size_t i = 0; i < data_.size(); i++)
+      data_[i] = static_cast<uint8_t>(i * 131 + 7);
+    arena_.prefault();
+    secrets_.resize(EC_BATCH);
+    for (size_t i = 0; i < EC_BATCH; i++) {
+      secrets_[i].fill(0);
+      secrets_[i][31] = static_cast<uint8_t>(i + 1);
+      secrets_[i][0] = 0x3c;
+    }
+    uint8_t pub[65];
+    size_t len = Secp256k1::publicKey(secrets_[0].data(), false, pub);
+    pub_.assign(pub, pub + len);
+  }
+
+  ScryptArena arena_;
+  std::vector<uint8_t> block_;
+  std::array<uint8_t, 64 * 1024> data_;
+  std::vector<SecretKey> secrets_;
+  std::vector<uint8_t> pub_;
+  uint8_t out_[64];
+};
+
+std::vector<Benchmark> benchmarks(Inputs& in) {
+  const ByteView pwd(in.data_.data(), 16);
+  const ByteView salt(in.data_.data() + 16, 16);
+  std::vector<Benchmark> list;
+
+  // SHA-256 compression, 64 KiB is 1024 blocks
+  list.push_back({"sha256-compress", "native", "block", BATCH, [&in] {
+                    Sha256 h;
+                    h.update(in.data_.data(), in.data_.size());
+                    h.final(in.out_);
+                  }});
+  list.push_back({"sha256-compress", "openssl", "block", BATCH, [&in] {
+                    SHA256(in.data_.data(), in.data_.size(), in.out_);
+                  }});
+
+  for (ScryptKernel k : scryptKernels()) {
+    std::string backend = std::string("native-") + scryptKernelName(k);
+    list.push_back({"salsa20/8-blockmix", backend, "blockmix", BATCH,
+                    [&in, k] { scryptBlockMix(in.arena_, k, BATCH); }});
+    list.push_back({"romix", backend, "romix", 1, [&in, k] {
+                      scryptRoMix(in.block_.data(), in.arena_, k);
+                    }});
+  }
+  list.push_back({"scrypt", std::string("native-") +
+                                scryptKernelName(scryptKernel()),
+                  "key", 1, [&in, pwd, salt] {
+                    scrypt(pwd.data(), pwd.size(), salt.data(), salt.size(), 1,
+                           in.out_, 32, in.arena_);
+                  }});
+  list.push_back({"scrypt", "openssl", "key", 1, [&in, pwd, salt] {
+                    EVP_PBE_scrypt(reinterpret_cast<const char*>(pwd.data()),
+                                   pwd.size(), salt.data(), salt.size(),
+                                   SCRYPT_N, SCRYPT_R, 1,
+                                   in.arena_.size() + 1024 * 1024, in.out_,
+                                   32);
+                  }});
+
+  list.push_back({"pbkdf2-hmac-sha256", "native", "key", 1, [&in, pwd, salt] {
+                    HmacSha256 prf(pwd);
+                    prf.pbkdf2(salt.data(), salt.size(), PBKDF2_ITERATIONS,
+                               in.out_, 32);
+                  }});
+  list.push_back({"pbkdf2-hmac-sha256", "openssl", "key", 1,
+                  [&in, pwd, salt] {
+                    PKCS5_PBKDF2_HMAC(reinterpret_cast<const char*>(pwd.data()),
+                                      pwd.size(), salt.data(), salt.size(),
+                                      PBKDF2_ITERATIONS, EVP_sha256(), 32,
+                                      in.out_);
+                  }});
+
+  // public keys one by one and in a batch sharing one field inversion
+  list.push_back({"secp256k1-pubkey", "native", "key", EC_BATCH, [&in] {
+                    uint8_t pub[65];
+                    for (const SecretKey& s : in.secrets_)
+                      Secp256k1::publicKey(s.data(), false, pub);
+                  }});
+  list.push_back({"secp256k1-pubkey", "native-batch", "key", EC_BATCH, [&in] {
+                    std::vector<Secp256k1::PointJ> sums(EC_BATCH);
+                    std::vector<Secp256k1::Point> points(EC_BATCH);
+                    for (size_t i = 0; i < EC_BATCH; i++)
+                      sums[i] = Secp256k1::multiplyG(in.secrets_[i].data());
+                    Secp256k1::toAffine(sums.data(), points.data(), EC_BATCH);
+                    uint8_t pub[65];
+                    for (const Secp256k1::Point& p : points)
+                      Secp256k1::serialize(p, false, pub);
+                  }});
+
+  list.push_back({"hash160", "native", "key", BATCH, [&in] {
+                    for (size_t i = 0; i < BATCH; i++)
+                      hash160(in.pub_.data(), in.pub_.size(), in.out_);
+                  }});
+  list.push_back({"base58check", "native", "address", BATCH, [&in] {
+                    std::string s;
+                    for (size_t i = 0; i < BATCH; i++)
+                      s = base58CheckEncode(in.data_.data() + i, 21);
+                  }});
+
+  CoinKeyPair coin = encodeKeyPair(CoinId::kBitCoin, in.pub_.data(),
+                                   in.pub_.size(), in.secrets_[0].data());
+  list.push_back({"json-serializer", "ndjson", "record", BATCH, [coin] {
+                    KeySerializer serializer(OptionsOutput(0xff), "password");
+                    std::string buf;
+                    const std::string label("ER8FT+HFjk0");
+                    for (size_t i = 0; i < BATCH; i++) {
+                      buf.clear();
+                      serializer.ndjson(buf, i, coin, label);
+                    }
+                  }});
+  return list;
+}
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app("WarpWallet Benchmarks");
+
+  std::string filter;
+  CLI::Option* opt_filter =
+      app.add_option("--filter", filter, "run benchmarks whose name contains");
+  opt_filter->set_default_val("all");
+
+  unsigned int warmup{1};
+  CLI::Option* opt_warmup =
+      app.add_option("--warmup", warmup, "untimed runs before measuring");
+  opt_warmup->set_default_val("1");
+
+  unsigned int runs{5};
+  CLI::Option* opt_runs =
+      app.add_option("-r,--repetitions", runs, "timed runs of each benchmark");
+  opt_runs->set_default_val("5");
+
+  std::string format{"json"};
+  CLI::Option* opt_format = app.add_set("-f,--format", format, {"json", "text"});
+  opt_format->set_type_name("output format {json | text}");
+  opt_format->set_default_val("json");
+
+  bool list_only{false};
+  app.add_flag("--list", list_only, "list benchmarks without running them");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError& e) {
+    return app.exit(e);
+  }
+
+  try {
+    if (runs == 0) throw std::out_of_range("bench: repetitions must be > 0");
+    Inputs inputs;
+    json out;
+    std::time_t t = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&t), "%FT%T%Z");
+    out["_time"] = ss.str();
+    out["machine"]["cpu"] = cpuModel();
+    out["machine"]["cores"] = std::thread::hardware_concurrency();
+    for (ScryptKernel k : scryptKernels())
+      out["machine"]["scryptKernels"].push_back(scryptKernelName(k));
+    out["config"]["warmup"] = warmup;
+    out["config"]["repetitions"] = runs;
+    out["benchmarks"] = json::array();
+
+    if (format == "text")
+      std::cout << std::left << std::setw(22) << "benchmark" << std::setw(14)
+                << "backend" << std::right << std::setw(12) << "median ms"
+                << std::setw(12) << "stddev ms" << std::setw(16)
+                << "items/s" << std::endl;
+
+    for (const Benchmark& b : benchmarks(inputs)) {
+      if (filter != "all" && b.name_.find(filter) == std::string::npos)
+        continue;
+      if (list_only) {
+        std::cout << b.name_ << ' ' << b.backend_ << std::endl;
+        continue;
+      }
+      Stats s = measure(b, warmup, runs);
+      double rate = b.items_ * 1000.0 / s.median_;
+      json r;
+      r["name"] = b.name_;
+      r["backend"] = b.backend_;
+      r["unit"] = b.unit_;
+      r["items"] = b.items_;
+      r["runs"] = s.runs_;
+      r["minMs"] = s.min_;
+      r["medianMs"] = s.median_;
+      r["meanMs"] = s.mean_;
+      r["stddevMs"] = s.stddev_;
+      r["maxMs"] = s.max_;
+      r["itemsPerSecond"] = rate;
+      out["benchmarks"].push_back(r);
+      if (format == "text")
+        std::cout << std::left << std::setw(22) << b.name_ << std::setw(14)
+                  << b.backend_ << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(12) << s.median_
+                  << std::setw(12) << s.stddev_ << std::setprecision(1)
+                  << std::setw(16) << rate << std::endl;
+    }
+    if (format == "json" && !list_only)
+      std::cout << std::setw(2) << out << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -23,12 +23,20 @@
 #include "CoinKeyPair.h"
 #include "CommandInterpreter.h"
 #include "RandomSeedGenerator.h"
+#include "StageStats.h"
 #include "WarpKeyGenerator.h"
 
 int main(int argc, char* argv[]) {
   try {
     UserInterface ui(std::cout);
     if (ui.parse(argc, argv)) {
+      // process wide, batch jobs and daemon share scrypt memory
+      WarpKeyGenerator::setHugePages(ui.huge_pages_);
+      if (!ui.scrypt_kernel_.empty())
+        WarpKeyGenerator::setKernel(ui.scrypt_kernel_);
+      StageStats::enable(ui.stats_);
+      // unavailable counters are reported in stats
+      StageStats::enablePerf(ui.perf_counters_);
       CommandInterpreter cmd(ui);
       cmd.execute();
       ui.show(cmd.result());
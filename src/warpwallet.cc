@@ -0,0 +1,223 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "CoinEncoding.h"
+#include "Secp256k1.h"
+#include "SecureMemory.h"
+#include "WarpEngine.h"
+#include "WarpKeyGenerator.h"
+#include "warpwallet.h"
+
+struct warp_context {
+  explicit warp_context(unsigned int threads) : engine_(threads) {}
+  WarpEngine engine_;
+};
+
+namespace {
+/// \brief Status code of exception thrown by core.
+int errorStatus(const std::exception_ptr& error) {
+  try {
+    std::rethrow_exception(error);
+  } catch (const std::bad_alloc&) {
+    return WARP_ERR_MEMORY;
+  } catch (const std::logic_error&) {
+    // invalid_argument, domain_error and out_of_range of argument checks
+    return WARP_ERR_ARGUMENT;
+  } catch (...) {
+    return WARP_ERR_INTERNAL;
+  }
+}
+
+/// \brief Status code of completed derivation.
+int resultStatus(const WarpKeyResult& result) {
+  if (result.error_) return errorStatus(result.error_);
+  switch (result.status_) {
+    case WarpKeyGenerator::kOk:
+      return WARP_OK;
+    case WarpKeyGenerator::kCancelled:
+      return WARP_ERR_CANCELLED;
+    case WarpKeyGenerator::kTimeout:
+      return WARP_ERR_TIMEOUT;
+    default:
+      return WARP_ERR_INTERNAL;
+  }
+}
+
+bool isNetwork(int network) {
+  return network >= WARP_BITCOIN && network <= WARP_LITECOIN_TEST;
+}
+
+int copyString(const std::string& s, char* out, size_t out_size) {
+  if (s.size() + 1 > out_size) return WARP_ERR_BUFFER;
+  std::memcpy(out, s.c_str(), s.size() + 1);
+  return WARP_OK;
+}
+
+/// \brief Runs 'count' derivations through engine and waits for them.
+void deriveAll(WarpEngine& engine, const warp_request* requests, size_t count,
+               uint8_t* secrets, int* status) {
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t remaining = count;
+  size_t i = 0;
+  try {
+    for (; i < count; i++) {
+      const warp_request& req = requests[i];
+      Password pwd(req.passphrase, req.passphrase + req.passphrase_len);
+      Password salt(req.salt, req.salt + req.salt_len);
+      uint8_t* secret = secrets + WARP_SECRET_SIZE * i;
+      int* st = status + i;
+      engine.submit(CoinId::kBitCoin, pwd, salt,
+                    [&, secret, st](const WarpKeyResult& result) {
+                      *st = resultStatus(result);
+                      if (*st == WARP_OK)
+                        std::copy(result.secret_.begin(),
+                                  result.secret_.end(), secret);
+                      std::lock_guard<std::mutex> lock(mutex);
+                      if (--remaining == 0) done.notify_all();
+                    });
+    }
+  } catch (...) {
+    // submitted requests refer to this frame, wait for them
+    std::unique_lock<std::mutex> lock(mutex);
+    remaining -= count - i;
+    done.wait(lock, [&] { return remaining == 0; });
+    throw;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return remaining == 0; });
+}
+}
+
+extern "C" {
+
+int warp_api_version(void) { return WARP_API_VERSION; }
+
+const char* warp_status_string(int status) {
+  switch (status) {
+    case WARP_OK:
+      return "ok";
+    case WARP_ERR_ARGUMENT:
+      return "invalid argument";
+    case WARP_ERR_BUFFER:
+      return "output buffer too small";
+    case WARP_ERR_CANCELLED:
+      return "cancelled";
+    case WARP_ERR_TIMEOUT:
+      return "timeout";
+    case WARP_ERR_MEMORY:
+      return "out of memory";
+    default:
+      return "internal error";
+  }
+}
+
+warp_context* warp_context_create(unsigned int threads) {
+  try {
+    return new warp_context(threads);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void warp_context_destroy(warp_context* ctx) { delete ctx; }
+
+unsigned int warp_context_threads(const warp_context* ctx) {
+  return (ctx ? static_cast<unsigned int>(ctx->engine_.threads()) : 0);
+}
+
+int warp_derive(warp_context* ctx, const uint8_t* passphrase,
+                size_t passphrase_len, const uint8_t* salt, size_t salt_len,
+                uint8_t* secret) {
+  warp_request req{passphrase, passphrase_len, salt, salt_len};
+  int status{WARP_OK};
+  int rc = warp_derive_batch(ctx, &req, 1, secret, &status);
+  return (rc == WARP_OK ? status : rc);
+}
+
+int warp_derive_batch(warp_context* ctx, const warp_request* requests,
+                      size_t count, uint8_t* secrets, int* status) {
+  if (!ctx || (count > 0 && (!requests || !secrets || !status)))
+    return WARP_ERR_ARGUMENT;
+  for (size_t i = 0; i < count; i++)
+    if ((!requests[i].passphrase && requests[i].passphrase_len) ||
+        (!requests[i].salt && requests[i].salt_len))
+      return WARP_ERR_ARGUMENT;
+  try {
+    deriveAll(ctx->engine_, requests, count, secrets, status);
+  } catch (...) {
+    return errorStatus(std::current_exception());
+  }
+  for (size_t i = 0; i < count; i++)
+    if (status[i] != WARP_OK) return status[i];
+  return WARP_OK;
+}
+
+int warp_public_key(const uint8_t* secret, int compressed, uint8_t* out,
+                    size_t out_size, size_t* out_len) {
+  if (!secret || !out || !out_len) return WARP_ERR_ARGUMENT;
+  size_t need = (compressed ? WARP_COMPRESSED_PUBLIC_KEY_SIZE
+                            : WARP_PUBLIC_KEY_SIZE);
+  if (out_size < need) return WARP_ERR_BUFFER;
+  try {
+    *out_len = Secp256k1::publicKey(secret, compressed != 0, out);
+  } catch (...) {
+    return errorStatus(std::current_exception());
+  }
+  return (*out_len == 0 ? WARP_ERR_ARGUMENT : WARP_OK);
+}
+
+int warp_address(int network, const uint8_t* secret, int compressed,
+                 char* out, size_t out_size) {
+  if (!isNetwork(network) || !out) return WARP_ERR_ARGUMENT;
+  uint8_t pub[WARP_PUBLIC_KEY_SIZE];
+  size_t len;
+  int rc = warp_public_key(secret, compressed, pub, sizeof(pub), &len);
+  if (rc != WARP_OK) return rc;
+  try {
+    uint8_t hash[20];
+    hash160(pub, len, hash);
+    return copyString(hash160ToAddress(CoinId(network), hash), out, out_size);
+  } catch (...) {
+    return errorStatus(std::current_exception());
+  }
+}
+
+int warp_wif(int network, const uint8_t* secret, int compressed, char* out,
+             size_t out_size) {
+  if (!isNetwork(network) || !secret || !out) return WARP_ERR_ARGUMENT;
+  if (!Secp256k1::isValidSecret(secret)) return WARP_ERR_ARGUMENT;
+  try {
+    std::string wif = secretToWif(CoinId(network), secret, compressed != 0);
+    int rc = copyString(wif, out, out_size);
+    secureWipe(&wif[0], wif.size());
+    return rc;
+  } catch (...) {
+    return errorStatus(std::current_exception());
+  }
+}
+}
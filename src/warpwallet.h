@@ -0,0 +1,131 @@
+/*
+** Copyright (c) 2017 Markku Pulkkinen. All rights reserved.
+** Contact: markku.j.pulkkinen@gmail.com
+**
+** This file is part of warpwallet-tool software distribution.
+**
+** This software is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Lesser General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This software is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with this software.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * C interface of warpwallet library (libwarpwallet).
+ *
+ * The interface is stable, functions are only added and existing
+ * signatures are not changed within major version WARP_API_VERSION.
+ * All output is written into caller provided buffers, functions return
+ * WARP_OK or a negative warp_status error code.
+ */
+
+#ifndef WARPWALLET_H
+#define WARPWALLET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(WARP_BUILD_LIBRARY)
+#define WARP_API __attribute__((visibility("default")))
+#else
+#define WARP_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WARP_API_VERSION 1
+
+/* sizes of fixed size outputs */
+#define WARP_SECRET_SIZE 32
+#define WARP_PUBLIC_KEY_SIZE 65
+#define WARP_COMPRESSED_PUBLIC_KEY_SIZE 33
+
+/* buffer size large enough for any address or WIF string, incl. NUL */
+#define WARP_STRING_SIZE 64
+
+typedef enum {
+  WARP_OK = 0,
+  WARP_ERR_ARGUMENT = -1,  /* invalid argument */
+  WARP_ERR_BUFFER = -2,    /* output buffer too small */
+  WARP_ERR_CANCELLED = -3, /* derivation cancelled */
+  WARP_ERR_TIMEOUT = -4,   /* derivation deadline passed */
+  WARP_ERR_MEMORY = -5,    /* out of memory */
+  WARP_ERR_INTERNAL = -6   /* unexpected error */
+} warp_status;
+
+typedef enum {
+  WARP_BITCOIN = 1,
+  WARP_BITCOIN_TEST = 2,
+  WARP_LITECOIN = 3,
+  WARP_LITECOIN_TEST = 4
+} warp_network;
+
+/* derivation request of batch, passphrase and salt are not copied */
+typedef struct {
+  const uint8_t* passphrase;
+  size_t passphrase_len;
+  const uint8_t* salt;
+  size_t salt_len;
+} warp_request;
+
+/* context owns worker threads and prefaulted scrypt memory */
+typedef struct warp_context warp_context;
+
+/* Returns WARP_API_VERSION of the library. */
+WARP_API int warp_api_version(void);
+
+/* Returns static description of status code. */
+WARP_API const char* warp_status_string(int status);
+
+/* Creates context with given worker threads, 0 = all cores. Workers are
+ * limited by available memory, each parallel derivation needs 256 MiB.
+ * Returns NULL on failure. */
+WARP_API warp_context* warp_context_create(unsigned int threads);
+
+/* Waits for running derivations and releases context. */
+WARP_API void warp_context_destroy(warp_context* ctx);
+
+/* Number of parallel derivations of context. */
+WARP_API unsigned int warp_context_threads(const warp_context* ctx);
+
+/* Derives WarpWallet secret of passphrase and salt into 32-byte 'secret'.
+ * Blocks until done. Thread safe, calls of several threads run in
+ * parallel. */
+WARP_API int warp_derive(warp_context* ctx, const uint8_t* passphrase,
+                         size_t passphrase_len, const uint8_t* salt,
+                         size_t salt_len, uint8_t* secret);
+
+/* Derives secrets of 'count' requests in parallel, secret of request i is
+ * written at secrets + 32 * i and its status into status[i]. Returns
+ * WARP_OK when all requests succeeded, otherwise first failed status. */
+WARP_API int warp_derive_batch(warp_context* ctx,
+                               const warp_request* requests, size_t count,
+                               uint8_t* secrets, int* status);
+
+/* Serialized public key of secret, 65 bytes or 33 bytes compressed.
+ * Length is written into 'out_len'. */
+WARP_API int warp_public_key(const uint8_t* secret, int compressed,
+                             uint8_t* out, size_t out_size, size_t* out_len);
+
+/* NUL terminated pay-to-pubkey-hash address of secret. */
+WARP_API int warp_address(int network, const uint8_t* secret, int compressed,
+                          char* out, size_t out_size);
+
+/* NUL terminated WIF encoding of secret. */
+WARP_API int warp_wif(int network, const uint8_t* secret, int compressed,
+                      char* out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WARPWALLET_H */
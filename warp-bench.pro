@@ -0,0 +1,45 @@
+TEMPLATE = app
+QT -= qt
+
+CONFIG += c++14 console thread release
+CONFIG -= app_bundle
+
+TARGET = warp-bench
+
+INCLUDEPATH = \
+    $$PWD/include \
+    $$PWD/externals/crypto/cppcrypto \
+    $$PWD/externals/bitcoin-tool/lib \
+//    $$PWD/externals/openssl/include
+
+DEPENDPATH = \
+    $$PWD/externals/bitcoin-tool/lib
+
+SOURCES = \
+    src/bench.cpp \
+    src/CoinEncoding.cc \
+    src/CoinKeyPair.cc \
+    src/KeySerializer.cc \
+    src/PerfCounters.cc \
+    src/ScryptEngine.cc \
+    src/Secp256k1.cc \
+    src/SecureMemory.cc \
+    src/Sha256Engine.cc \
+    src/StageStats.cc
+
+HEADERS = \
+    src/ByteView.h \
+    src/CancelToken.h \
+    src/CoinEncoding.h \
+    src/CoinKeyPair.h \
+    src/KeySerializer.h \
+    src/PerfCounters.h \
+    src/ScryptEngine.h \
+    src/Secp256k1.h \
+    src/SecureMemory.h \
+    src/Sha256Engine.h \
+    src/StageStats.h
+
+unix:!macx: LIBS += -L$$PWD/externals/crypto/cppcrypto/ -lcppcrypto
+unix:!macx: LIBS += -L$$PWD/externals/bitcoin-tool/lib/ -lbitcointool
+unix:!macx: LIBS += -lcrypto -lssl -lpthread
@@ -0,0 +1,74 @@
+TEMPLATE = lib
+QT -= qt
+
+CONFIG += c++14 shared thread debug_and_release
+
+TARGET = warpwallet
+VERSION = 1.0.0
+
+# only the C interface of src/warpwallet.h is exported
+DEFINES += WARP_BUILD_LIBRARY
+QMAKE_CXXFLAGS += -fvisibility=hidden -fvisibility-inlines-hidden
+
+INCLUDEPATH = \
+    $$PWD/include \
+    $$PWD/externals/crypto/cppcrypto \
+    $$PWD/externals/bitcoin-tool/lib \
+//    $$PWD/externals/openssl/include
+
+DEPENDPATH = \
+    $$PWD/externals/bitcoin-tool/lib
+
+SOURCES = \
+    src/WarpKeyGenerator.cc \
+    src/CoinKeyPair.cc \
+    src/CoinEncoding.cc \
+    src/RandomSeedGenerator.cc \
+    src/RootKeyCache.cc \
+    src/AtomicFile.cc \
+    src/DerivationCache.cc \
+    src/HDWallet.cc \
+    src/KeyExport.cc \
+    src/KeySerializer.cc \
+    src/KeyWriter.cc \
+    src/PerfCounters.cc \
+    src/ProgressMeter.cc \
+    src/ScryptEngine.cc \
+    src/Secp256k1.cc \
+    src/SecureMemory.cc \
+    src/Sha256Engine.cc \
+    src/StageStats.cc \
+    src/ThreadPool.cc \
+    src/WarpEngine.cc \
+    src/warpwallet.cc
+
+HEADERS = \
+    src/WarpKeyGenerator.h \
+    src/CoinKeyPair.h \
+    src/ByteView.h \
+    src/CancelToken.h \
+    src/CoinEncoding.h \
+    src/RandomSeedGenerator.h \
+    src/RootKeyCache.h \
+    src/AtomicFile.h \
+    src/DerivationCache.h \
+    src/HDWallet.h \
+    src/KeyExport.h \
+    src/KeySerializer.h \
+    src/KeyWriter.h \
+    src/PerfCounters.h \
+    src/ProgressMeter.h \
+    src/ScryptEngine.h \
+    src/Secp256k1.h \
+    src/SecureMemory.h \
+    src/Sha256Engine.h \
+    src/StageStats.h \
+    src/ThreadPool.h \
+    src/WarpEngine.h \
+    src/warpwallet.h
+
+unix:!macx: LIBS += -L$$PWD/externals/crypto/cppcrypto/ -lcppcrypto
+unix:!macx: LIBS += -L$$PWD/externals/bitcoin-tool/lib/ -lbitcointool
+#unix:!macx: LIBS += -lpthread -ldl
+#unix:!macx: LIBS += -L$$PWD/externals/openssl/ -lssl -lcrypto
+unix:!macx: LIBS += -lcrypto -lssl -lpthread
@@ -31,16 +31,61 @@ SOURCES = \
     src/main.cpp \
     src/WarpKeyGenerator.cc \
     src/CoinKeyPair.cc \
+    src/CoinEncoding.cc \
     src/RandomSeedGenerator.cc \
+    src/RootKeyCache.cc \
+    src/AtomicFile.cc \
     src/CommandInterpreter.cc \
-    src/UserInterface.cc
+    src/DerivationCache.cc \
+    src/HDWallet.cc \
+    src/JobServer.cc \
+    src/KeyExport.cc \
+    src/KeyPipeline.cc \
+    src/KeySerializer.cc \
+    src/MachineProfile.cc \
+    src/KeyWriter.cc \
+    src/PerfCounters.cc \
+    src/ProgressMeter.cc \
+    src/ScryptEngine.cc \
+    src/Secp256k1.cc \
+    src/SecureMemory.cc \
+    src/Sha256Engine.cc \
+    src/StageStats.cc \
+    src/TestVectors.cc \
+    src/ThreadPool.cc \
+    src/UserInterface.cc \
+    src/WarpEngine.cc
 
 HEADERS = \
     src/WarpKeyGenerator.h \
     src/CoinKeyPair.h \
+    src/ByteView.h \
+    src/CancelToken.h \
+    src/CoinEncoding.h \
     src/RandomSeedGenerator.h \
+    src/RootKeyCache.h \
+    src/AtomicFile.h \
     src/CommandInterpreter.h \
-    src/UserInterface.h
+    src/DerivationCache.h \
+    src/HDWallet.h \
+    src/JobServer.h \
+    src/KeyExport.h \
+    src/KeyPipeline.h \
+    src/KeySerializer.h \
+    src/KeyWriter.h \
+    src/LockFreeQueue.h \
+    src/MachineProfile.h \
+    src/PerfCounters.h \
+    src/ProgressMeter.h \
+    src/ScryptEngine.h \
+    src/Secp256k1.h \
+    src/SecureMemory.h \
+    src/Sha256Engine.h \
+    src/StageStats.h \
+    src/TestVectors.h \
+    src/ThreadPool.h \
+    src/UserInterface.h \
+    src/WarpEngine.h
 
 DISTFILES = \
     warp-util.pro.user